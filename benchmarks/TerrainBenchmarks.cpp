@@ -0,0 +1,454 @@
+/**
+ * Micro and macro benchmarks for the simulation core (Google Benchmark).
+ * Every benchmark reports throughput (droplets/s or cells/s) and the bytes allocated per
+ * iteration. Use --benchmark_format=json or --benchmark_out=results.json to keep results
+ * for regression tracking between releases.
+ */
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "ErosionModel.h"
+#include "HeightField.h"
+#include "HydraulicErosion.h"
+#include "PerlinNoiseGenerator.h"
+#include "PerlinRow.h"
+#include "PyramidErosion.h"
+#include "ShallowWaterErosion.h"
+#include "ThermalErosion.h"
+#include "TiledHeightField.h"
+#include "TiledTerrain.h"
+#include "TerrainMesh.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+// Allocation tracking: every global new in this process is counted so benchmarks can report bytes allocated
+//----------------------------------------------------------------------------------------------------------------------
+namespace
+{
+std::atomic<std::size_t> g_bytesAllocated{0};
+
+void* countedAlloc(std::size_t size, std::size_t alignment)
+{
+    g_bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    void* p = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        p = std::malloc(size == 0 ? 1 : size);
+    } else {
+        // aligned_alloc wants the size to be a multiple of the alignment
+        p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    if (p == nullptr) { throw std::bad_alloc(); }
+    return p;
+}
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size) { return countedAlloc(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return countedAlloc(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return countedAlloc(size, static_cast<std::size_t>(alignment)); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace
+{
+// Adds a bytes_allocated (per iteration) counter covering the lifetime of the scope
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State& state)
+        : m_state(state), m_start(g_bytesAllocated.load(std::memory_order_relaxed)) {}
+    ~AllocationCounter() {
+        double bytes = static_cast<double>(g_bytesAllocated.load(std::memory_order_relaxed) - m_start);
+        m_state.counters["bytes_allocated"] = benchmark::Counter(bytes, benchmark::Counter::kAvgIterations,
+                                                                 benchmark::Counter::kIs1024);
+    }
+
+private:
+    benchmark::State& m_state;
+    std::size_t m_start;
+};
+
+void setCellsPerSecond(benchmark::State& state, std::size_t cells)
+{
+    state.counters["cells_per_second"] = benchmark::Counter(static_cast<double>(cells) * state.iterations(),
+                                                            benchmark::Counter::kIsRate);
+}
+
+// Fixed input terrain so every run erodes the same heights
+HeightField makeTerrain(unsigned int size)
+{
+    HeightField heightField(size, size, 1.0f);
+    PerlinNoiseGenerator generator(3.0f, 6, 90);
+    generator.generateTerrain(heightField, 90);
+    return heightField;
+}
+
+// Erosion models as the app sets them up: 0 = droplets, 1 = virtual pipes, 2 = talus only
+std::unique_ptr<ErosionModel> makeErosionModel(std::int64_t index)
+{
+    if (index == 1) {
+        return std::make_unique<ShallowWaterErosion>();
+    }
+    if (index == 2) {
+        return std::make_unique<ThermalErosion>();
+    }
+    auto droplets = std::make_unique<HydraulicErosion>();
+    droplets->setTileSize(64);
+    droplets->setBatchedSimulation(true);
+    droplets->setTrailRecording(false);
+    droplets->setTalusIterations(4);
+    droplets->getTalusPass().setTalusSlope(2.0f);
+    return droplets;
+}
+
+double meanAbsoluteChange(const HeightField& before, const HeightField& after)
+{
+    double sum = 0.0;
+    for (std::size_t i = 0; i < before.size(); ++i) {
+        sum += std::fabs(static_cast<double>(after.data()[i]) - before.data()[i]);
+    }
+    return sum / static_cast<double>(before.size());
+}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// Noise generation
+//----------------------------------------------------------------------------------------------------------------------
+static void BM_GenerateTerrain(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    HeightField heightField(size, size, 1.0f);
+    PerlinNoiseGenerator generator(3.0f, static_cast<int>(state.range(1)), 90);
+    // Full generation every iteration, see BM_RegenerateOctaves for the cached path
+    generator.setOctaveCacheBudget(0);
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        generator.generateTerrain(heightField, 90);
+        benchmark::DoNotOptimize(heightField.data());
+    }
+    setCellsPerSecond(state, heightField.size());
+}
+BENCHMARK(BM_GenerateTerrain)
+    ->ArgNames({"size", "octaves"})
+    ->ArgsProduct({{256, 1024, 4096}, {6}})
+    ->Args({1024, 1})
+    ->Args({1024, 8})
+    ->Unit(benchmark::kMillisecond);
+
+// UI style tweaks on a cached generator: one octave more or less, or only a new height
+static void BM_RegenerateOctaves(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    const bool heightOnly = state.range(1) != 0;
+    HeightField heightField(size, size, 1.0f);
+    PerlinNoiseGenerator generator(3.0f, 6, 90);
+    generator.setOctaveCacheBudget(std::size_t(1) << 30);
+    generator.generateTerrain(heightField, 90);
+    generator.setOctaves(7);
+    generator.generateTerrain(heightField, 90);
+
+    AllocationCounter allocations(state);
+    int iteration = 0;
+    for (auto _ : state) {
+        ++iteration;
+        if (heightOnly) {
+            generator.generateTerrain(heightField, 80 + iteration % 2);
+        } else {
+            generator.setOctaves(6 + iteration % 2);
+            generator.generateTerrain(heightField, 90);
+        }
+        benchmark::DoNotOptimize(heightField.data());
+    }
+    setCellsPerSecond(state, heightField.size());
+}
+BENCHMARK(BM_RegenerateOctaves)
+    ->ArgNames({"size", "heightOnly"})
+    ->ArgsProduct({{1024, 4096}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// One 4096 wide row of 6 octave fBm, per point octave2D calls against the batched row kernel
+static void BM_Octave2DRow(benchmark::State& state)
+{
+    const bool batched = state.range(0) != 0;
+    const int width = 4096;
+    const siv::PerlinNoise perlin{123456u};
+    std::vector<double> x(width);
+    std::vector<double> out(width);
+    for (int i = 0; i < width; ++i) {
+        x[i] = 3.0 * i / (width - 1);
+    }
+
+    AllocationCounter allocations(state);
+    double y = 0.0;
+    for (auto _ : state) {
+        if (batched) {
+            octave2DRow(perlin, x.data(), y, width, 6, 0.5, out.data());
+        } else {
+            for (int i = 0; i < width; ++i) {
+                out[i] = perlin.octave2D(x[i], y, 6, 0.5);
+            }
+        }
+        benchmark::DoNotOptimize(out.data());
+        y += 0.001;
+    }
+    setCellsPerSecond(state, width);
+}
+BENCHMARK(BM_Octave2DRow)->ArgName("batched")->Arg(0)->Arg(1);
+
+//----------------------------------------------------------------------------------------------------------------------
+// Erosion building blocks
+//----------------------------------------------------------------------------------------------------------------------
+static void BM_ComputeAreaOfInfluence(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    const auto radius = static_cast<float>(state.range(1));
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        // A fresh object each time so the cached stencil is really rebuilt
+        HydraulicErosion erosion;
+        erosion.computeAreaOfInfluence(size, size, radius);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_ComputeAreaOfInfluence)
+    ->ArgNames({"size", "radius"})
+    ->ArgsProduct({{256, 4096}, {2, 3, 6}});
+
+static void BM_GetHeightAndGradient(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    HeightField heightField = makeTerrain(size);
+    HydraulicErosion erosion;
+
+    // Walk a fixed pseudo random set of sample points so the access pattern resembles droplets
+    std::vector<float> samples(2 * 4096);
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = std::fmod(static_cast<float>(i) * 97.31f, static_cast<float>(size - 1));
+    }
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < samples.size(); i += 2) {
+            benchmark::DoNotOptimize(erosion.getHeightAndGradient(heightField, samples[i], samples[i + 1]));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(samples.size() / 2));
+}
+BENCHMARK(BM_GetHeightAndGradient)->ArgName("size")->Arg(256)->Arg(4096);
+
+//----------------------------------------------------------------------------------------------------------------------
+// Full erosion runs, reported as droplets per second (items_per_second)
+//----------------------------------------------------------------------------------------------------------------------
+static void erodeBenchmark(benchmark::State& state, int tileSize, bool batched)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    const auto droplets = static_cast<int>(state.range(1));
+    const auto radius = static_cast<int>(state.range(2));
+    const HeightField input = makeTerrain(size);
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        state.PauseTiming();
+        HeightField heightField = input;
+        HydraulicErosion erosion;
+        erosion.setErosionRadius(radius);
+        erosion.setTileSize(tileSize);
+        erosion.setBatchedSimulation(batched);
+        state.ResumeTiming();
+
+        erosion.erode(heightField, droplets, 30);
+        benchmark::DoNotOptimize(heightField.data());
+    }
+    state.SetItemsProcessed(state.iterations() * droplets);
+}
+
+static void BM_Erode(benchmark::State& state) { erodeBenchmark(state, 0, false); }
+static void BM_ErodeBatched(benchmark::State& state) { erodeBenchmark(state, 0, true); }
+static void BM_ErodeTiled(benchmark::State& state) { erodeBenchmark(state, 64, true); }
+
+#define EROSION_ARGS(bm)                                                     \
+    BENCHMARK(bm)                                                            \
+        ->ArgNames({"size", "droplets", "radius"})                           \
+        ->ArgsProduct({{256, 1024, 4096}, {10000, 100000}, {3}})             \
+        ->Args({1024, 100000, 2})                                            \
+        ->Args({1024, 100000, 6})                                            \
+        ->Unit(benchmark::kMillisecond)                                      \
+        ->UseRealTime()
+
+EROSION_ARGS(BM_Erode);
+EROSION_ARGS(BM_ErodeBatched);
+EROSION_ARGS(BM_ErodeTiled);
+
+//----------------------------------------------------------------------------------------------------------------------
+// Pipe model steps, reported as cells per second (items_per_second)
+//----------------------------------------------------------------------------------------------------------------------
+static void BM_ShallowWaterStep(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    constexpr int kSteps = 10;
+    const HeightField input = makeTerrain(size);
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        state.PauseTiming();
+        HeightField heightField = input;
+        ShallowWaterErosion erosion;
+        state.ResumeTiming();
+
+        erosion.erode(heightField, kSteps);
+        benchmark::DoNotOptimize(heightField.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kSteps * static_cast<int64_t>(size) * size);
+}
+BENCHMARK(BM_ShallowWaterStep)->ArgName("size")->Arg(256)->Arg(1024)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//----------------------------------------------------------------------------------------------------------------------
+// Talus sweeps, reported as cells per second (items_per_second). A talus slope of 0 keeps every sweep busy.
+//----------------------------------------------------------------------------------------------------------------------
+static void BM_ThermalSweep(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    constexpr int kSweeps = 4;
+    HeightField heightField = makeTerrain(size);
+    ThermalErosion erosion;
+    erosion.setTalusSlope(0.0f);
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        erosion.erode(heightField, kSweeps);
+        benchmark::DoNotOptimize(heightField.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kSweeps * static_cast<int64_t>(size) * size);
+}
+BENCHMARK(BM_ThermalSweep)->ArgName("size")->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//----------------------------------------------------------------------------------------------------------------------
+// Erosion models side by side through ErosionModel: same terrain, `steps` steps of the model's iterations.
+// mean_change is the average absolute height change, a rough measure of how much each model carved.
+// levels > 0 wraps the model in a PyramidErosion, which runs the same iterations in its larger steps.
+//----------------------------------------------------------------------------------------------------------------------
+static void BM_ErosionModel(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(1));
+    const auto steps = static_cast<int>(state.range(2));
+    const auto levels = static_cast<int>(state.range(3));
+    const HeightField input = makeTerrain(size);
+    double meanChange = 0.0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        HeightField heightField = input;
+        std::unique_ptr<ErosionModel> erosion = makeErosionModel(state.range(0));
+        const int iterations = steps * erosion->getStepSize();
+        if (levels > 0) {
+            erosion = std::make_unique<PyramidErosion>(std::move(erosion), levels);
+        }
+        state.ResumeTiming();
+
+        for (int done = 0; done < iterations; done += erosion->getStepSize()) {
+            erosion->erode(heightField, std::min(erosion->getStepSize(), iterations - done));
+        }
+        benchmark::DoNotOptimize(heightField.data());
+
+        state.PauseTiming();
+        meanChange = meanAbsoluteChange(input, heightField);
+        state.SetLabel(levels > 0 ? std::string("pyramid ") + PyramidErosion::fullResolutionModel(*erosion).getName()
+                                  : std::string(erosion->getName()));
+        state.ResumeTiming();
+    }
+    state.counters["mean_change"] = meanChange;
+}
+BENCHMARK(BM_ErosionModel)
+    ->ArgNames({"model", "size", "steps", "levels"})
+    ->ArgsProduct({{0, 1, 2}, {256, 1024}, {32}, {0, 2}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+//----------------------------------------------------------------------------------------------------------------------
+// Out of core erosion: the same droplets as BM_ErodeTiled streamed over 1024^2 tile files with four tiles mapped,
+// reported as droplets per second. The difference to BM_ErodeTiled is the halo work and the tile copies.
+//----------------------------------------------------------------------------------------------------------------------
+static void BM_ErodeOutOfCore(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    const auto droplets = static_cast<int>(state.range(1));
+    const auto halo = static_cast<unsigned int>(state.range(2));
+    const std::string directory = (std::filesystem::temp_directory_path() / "TerrainBenchmarksTiles").string();
+    TiledHeightField field;
+    if (!field.create(directory, size, size, 1.0f)) {
+        state.SkipWithError("Could not create the tile directory");
+        return;
+    }
+    field.setCacheCapacity(4);
+    PerlinNoiseGenerator generator(3.0f, 6, 90);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        generateTiled(generator, field, 90);
+        HydraulicErosion erosion;
+        erosion.setTileSize(64);
+        erosion.setBatchedSimulation(true);
+        erosion.setTrailRecording(false);
+        state.ResumeTiming();
+
+        erodeTiled(erosion, field, droplets, halo);
+    }
+    state.SetItemsProcessed(state.iterations() * droplets);
+    field.close();
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+}
+BENCHMARK(BM_ErodeOutOfCore)
+    ->ArgNames({"size", "droplets", "halo"})
+    ->Args({4096, 100000, 64})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+//----------------------------------------------------------------------------------------------------------------------
+// Meshing (the CPU half of Plane::buildTriangleMeshFromGrid)
+//----------------------------------------------------------------------------------------------------------------------
+static void BM_BuildGridVertices(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    HeightField heightField = makeTerrain(size);
+    std::vector<ngl::Vec3> vertices;
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        buildGridVertices(heightField, vertices);
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    setCellsPerSecond(state, heightField.size());
+}
+BENCHMARK(BM_BuildGridVertices)->ArgName("size")->Arg(256)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+// Only rebuilt when the grid size changes, measured for completeness
+static void BM_BuildGridIndices(benchmark::State& state)
+{
+    const auto size = static_cast<unsigned int>(state.range(0));
+    std::vector<std::uint32_t> indices;
+
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        buildGridIndices(size, size, indices);
+        benchmark::DoNotOptimize(indices.data());
+    }
+    setCellsPerSecond(state, static_cast<std::size_t>(size) * size);
+}
+BENCHMARK(BM_BuildGridIndices)->ArgName("size")->Arg(256)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,45 @@
+/**
+ * Counter based random numbers (SplitMix64 mixing).
+ * Every value is a pure function of (seed, index, stream), so any droplet can draw its
+ * numbers independently of the order or thread it runs on, which keeps erosion bakes
+ * reproducible no matter how the work is scheduled.
+ */
+
+#ifndef COUNTERRANDOM_H
+#define COUNTERRANDOM_H
+
+#include <cstdint>
+
+class CounterRandom {
+public:
+    explicit CounterRandom(std::uint64_t seed = 0) : m_seed(seed) {}
+
+    void setSeed(std::uint64_t seed) { m_seed = seed; }
+    std::uint64_t getSeed() const { return m_seed; }
+
+    // 64 random bits for the given counter, stream separates independent values drawn for the same index
+    std::uint64_t bits(std::uint64_t index, std::uint32_t stream = 0) const {
+        return mix(mix(m_seed + index * kGolden) ^ (static_cast<std::uint64_t>(stream) * kStreamStep));
+    }
+
+    // Uniform float in [0, 1) built from the top 24 bits so every value is exactly representable
+    float uniform(std::uint64_t index, std::uint32_t stream = 0) const {
+        return static_cast<float>(bits(index, stream) >> 40) * (1.0f / 16777216.0f);
+    }
+
+    // SplitMix64 finaliser
+    static std::uint64_t mix(std::uint64_t x) {
+        x += kGolden;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+private:
+    static constexpr std::uint64_t kGolden = 0x9E3779B97F4A7C15ull;
+    static constexpr std::uint64_t kStreamStep = 0xD1B54A32D192ED03ull;
+
+    std::uint64_t m_seed;
+};
+
+#endif //COUNTERRANDOM_H
@@ -0,0 +1,52 @@
+/**
+ * Marks which square tiles of a grid have changed since it was last cleared.
+ * Erosion marks the footprint of every droplet, renderers then upload only the dirty tiles
+ * instead of the whole grid. One byte per tile, 32x32 node tiles by default.
+ */
+
+#ifndef DIRTYTILEMAP_H
+#define DIRTYTILEMAP_H
+
+#include <vector>
+#include "HeightField.h"
+
+class DirtyTileMap {
+public:
+    static constexpr int kDefaultTileSize = 32;
+
+    // Sets the grid the tiles cover and clears every tile, does nothing if the size is unchanged
+    void resize(unsigned int width, unsigned int depth, int tileSize = kDefaultTileSize);
+    void clear();
+
+    // Marks every tile overlapping rect (clamped to the grid)
+    void mark(const GridRect& rect);
+    void markAll();
+    // Adds the tiles marked in other, adopting its size if this map has none yet
+    void unite(const DirtyTileMap& other);
+
+    bool any() const { return !m_bounds.empty(); }
+    bool allDirty() const { return m_dirtyCount == m_tiles.size() && !m_tiles.empty(); }
+    bool isDirty(int tileX, int tileZ) const { return m_tiles[tileZ * m_tilesX + tileX] != 0; }
+    // Nodes covered by a tile, the last row and column of tiles may be smaller
+    GridRect tileRect(int tileX, int tileZ) const;
+    // Smallest rectangle of nodes containing every marked tile
+    const GridRect& getBounds() const { return m_bounds; }
+
+    unsigned int getWidth() const { return m_width; }
+    unsigned int getDepth() const { return m_depth; }
+    int getTileSize() const { return m_tileSize; }
+    int getTilesX() const { return m_tilesX; }
+    int getTilesZ() const { return m_tilesZ; }
+
+private:
+    std::vector<unsigned char> m_tiles;
+    std::size_t m_dirtyCount = 0;
+    GridRect m_bounds;
+    unsigned int m_width = 0;
+    unsigned int m_depth = 0;
+    int m_tileSize = kDefaultTileSize;
+    int m_tilesX = 0;
+    int m_tilesZ = 0;
+};
+
+#endif //DIRTYTILEMAP_H
@@ -9,6 +9,8 @@
 #include <ngl/MultiBufferVAO.h>
 #include <memory>
 #include <QObject>
+#include "TrailBuffer.h"
+#include "TrailUploadTracker.h"
 
 /**
 * Provides visualization for water droplet movement
@@ -35,10 +37,11 @@ public :
 
     
     /**
-     * Draw trail points for droplet visualization
-     * @param _points Vector of points to visualize (x,y,z,lifetime)
+     * Draw trail points for droplet visualization, uploading only the points added since the last call.
+     * Expects the TrailShader (colour from the lifetime in w) to be in use
+     * @param _points Ring of points to visualize (x,y,z,lifetime)
      */
-    void drawTrailPoints(const std::vector<ngl::Vec4> &_points) const;
+    void drawTrailPoints(const TrailBuffer &_points);
 
     /**
      * Enable or disable trail point visualization
@@ -57,6 +60,9 @@ public slots:
 
 private :
     std::unique_ptr<ngl::MultiBufferVAO> m_vao;
+    // GPU copy of the trail ring, slot for slot
+    TrailUploadTracker m_trailUpload;
+    size_t m_trailDrawCount = 0;
     bool m_showTrailPoints = true;
 
     // From old emitter code, might use later
@@ -0,0 +1,59 @@
+/*
+ *Interface for erosion strategies, mirrors TerrainGenerator. Implemented by the droplet model
+ *(HydraulicErosion), the grid based pipe model (ShallowWaterErosion), talus slumping (ThermalErosion)
+ *and the coarse to fine wrapper around any of them (PyramidErosion)
+ */
+
+#ifndef EROSIONMODEL_H
+#define EROSIONMODEL_H
+
+#include <memory>
+#include "DirtyTileMap.h"
+#include "HeightField.h"
+
+// Settings every model understands, anything model specific stays on the concrete class.
+// Each model reads the rates in its own units, so compare models on their own defaults.
+struct ErosionParameters {
+    float erosionRate = 0.2f;     // how fast moving water picks up material
+    float depositionRate = 0.1f;  // how fast material above the carrying capacity settles
+    float evaporationRate = 0.1f; // how fast water is lost
+    unsigned int threads = 0;     // worker threads, 0 uses every hardware thread
+};
+
+class ErosionModel {
+public:
+    virtual ~ErosionModel() = default;
+
+    // Short name for logs, benchmarks and the UI
+    virtual const char* getName() const = 0;
+    // Copy with the same settings and state, e.g. to erode on a worker thread
+    virtual std::unique_ptr<ErosionModel> clone() const = 0;
+
+    virtual void setParameters(const ErosionParameters& parameters) = 0;
+    virtual ErosionParameters getParameters() const = 0;
+
+    // Runs `iterations` units of the model on the height field:
+    // droplets for particle models, time steps for grid models
+    virtual void erode(HeightField& heightField, int iterations) = 0;
+    // Units in one step(), small enough to report progress and cancel between steps
+    virtual int getStepSize() const = 0;
+    void step(HeightField& heightField) { erode(heightField, getStepSize()); }
+    // Drops the state carried between erode() calls, for a fresh terrain
+    virtual void reset() = 0;
+    // Ends a run whose model state won't be used again, e.g. on a worker's copy: puts any material
+    // the model still carries back onto the terrain and drops the rest of the state like reset()
+    virtual void settle(HeightField& /*heightField*/) {}
+    // How many iterations on a grid `factor` times coarser do the work of `iterations` here, see
+    // PyramidErosion. A droplet or a sweep reaches factor^2 times the area there, so fewer do.
+    virtual int coarseIterations(int iterations, int factor) const { return iterations / (factor * factor); }
+    // How many iterations on a part of the grid holding `share` of its nodes do their part of `iterations`
+    // on the whole grid, see erodeTiled. Sweeps and time steps act on every node, so all of them by default.
+    virtual int regionIterations(int iterations, double /*share*/) const { return iterations; }
+
+    // Tiles changed since the last clearDirtyTiles(), so renderers can upload only those
+    virtual const DirtyTileMap& getDirtyTiles() const = 0;
+    virtual void clearDirtyTiles() = 0;
+
+};
+
+#endif //EROSIONMODEL_H
@@ -0,0 +1,82 @@
+/**
+ * Runs an ErosionModel on a background thread so the GUI keeps drawing.
+ * The worker erodes its own copy of the height field one model step at a time and publishes snapshots
+ * (heights, dirty tiles and, for the droplet model, new trail points and the droplet counter) through a triple buffer. The GL
+ * thread swaps the latest snapshot out when it is told one is ready, so neither side
+ * waits on the other for more than a buffer swap.
+ *
+ * Usage: move the worker to a QThread, connect QThread::started to run() and the
+ * snapshotReady/finished signals to the GL widget, which calls takeSnapshot().
+ */
+
+#ifndef EROSIONWORKER_H
+#define EROSIONWORKER_H
+
+#include <QObject>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "DirtyTileMap.h"
+#include "ErosionModel.h"
+#include "HeightField.h"
+#include "HydraulicErosion.h"
+#include "TrailBuffer.h"
+
+struct ErosionSnapshot {
+    HeightField heightField;
+    TrailBuffer trailPoints;            // points added since the previous snapshot, droplet model only
+    DirtyTileMap dirtyTiles;            // tiles changed since the previous snapshot
+    std::uint64_t dropletCounter = 0;   // droplet model only
+    int iterationsDone = 0;
+};
+
+class ErosionWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // Takes copies of the terrain and the model, the originals stay with the GUI thread.
+    // totalIterations is in the model's units (droplets or time steps).
+    ErosionWorker(const HeightField& heightField, const ErosionModel& erosion, int totalIterations);
+
+    // Thread safe, the worker stops after the chunk it is running
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+    // Called from the GL thread. Swaps the latest snapshot into the argument and returns true,
+    // or returns false if nothing new was published since the last call. The trail points and
+    // dirty tiles handed back only cover what changed since the previous successful call.
+    bool takeSnapshot(ErosionSnapshot& snapshot);
+
+    int getTotalIterations() const { return m_totalIterations; }
+
+public slots:
+    void run();
+
+signals:
+    void progress(int iterationsDone, int totalIterations);
+    void snapshotReady();
+    void finished(bool cancelled);
+
+private:
+    void publishSnapshot(int iterationsDone);
+    // Minimum time between published snapshots, about one frame at 60 fps
+    static constexpr int kSnapshotIntervalMs = 16;
+
+    // Worker thread only
+    HeightField m_heightField;
+    // Copy of m_heightField for the next snapshot, filled without holding m_snapshotMutex
+    HeightField m_backHeightField;
+    std::unique_ptr<ErosionModel> m_erosion;
+    // The droplet model doing m_erosion's full resolution work, if any, for trails and the droplet counter
+    HydraulicErosion* m_droplets = nullptr;
+    int m_totalIterations;
+    std::atomic<bool> m_cancelled{false};
+
+    // Shared with the GL thread, guarded by m_snapshotMutex
+    std::mutex m_snapshotMutex;
+    ErosionSnapshot m_snapshot;
+    bool m_snapshotFresh = false;
+};
+
+#endif //EROSIONWORKER_H
@@ -0,0 +1,104 @@
+/**
+ * Height field used by terrain generation and erosion.
+ * Only the height of each grid node is stored, row by row (index = z * width + x).
+ * The x/z position of a node follows from its grid coordinate and the spacing, so the
+ * simulation streams through a third of the memory a std::vector<ngl::Vec3> grid needs.
+ * Heights are kept in one contiguous, cache line aligned float array so rows can be
+ * processed with aligned SIMD loads. World positions are only built when a mesh is needed.
+ */
+
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <ngl/Vec3.h>
+
+// Minimal allocator returning memory aligned to Alignment bytes
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+// Half open rectangle of grid nodes [minX, maxX) x [minZ, maxZ), e.g. the nodes changed by erosion
+struct GridRect {
+    int minX = 0;
+    int minZ = 0;
+    int maxX = 0;
+    int maxZ = 0;
+
+    bool empty() const { return minX >= maxX || minZ >= maxZ; }
+    // Grows the rectangle to also cover other, an empty rectangle adopts it
+    void unite(const GridRect& other) {
+        if (other.empty()) { return; }
+        if (empty()) { *this = other; return; }
+        minX = std::min(minX, other.minX);
+        minZ = std::min(minZ, other.minZ);
+        maxX = std::max(maxX, other.maxX);
+        maxZ = std::max(maxZ, other.maxZ);
+    }
+};
+
+class HeightField {
+public:
+    static constexpr std::size_t kAlignment = 64;
+
+    HeightField() = default;
+    HeightField(unsigned int width, unsigned int depth, float spacing, float initialHeight = 0.0f);
+
+    // Resizes the grid and sets every height to initialHeight
+    void resize(unsigned int width, unsigned int depth, float spacing, float initialHeight = 0.0f);
+    void clear();
+
+    unsigned int getWidth() const { return m_width; }
+    unsigned int getDepth() const { return m_depth; }
+    float getSpacing() const { return m_spacing; }
+    std::size_t size() const { return m_heights.size(); }
+    bool empty() const { return m_heights.empty(); }
+
+    std::size_t index(unsigned int x, unsigned int z) const { return static_cast<std::size_t>(z) * m_width + x; }
+
+    float& operator[](std::size_t i) { return m_heights[i]; }
+    float operator[](std::size_t i) const { return m_heights[i]; }
+    float& at(unsigned int x, unsigned int z) { return m_heights[index(x, z)]; }
+    float at(unsigned int x, unsigned int z) const { return m_heights[index(x, z)]; }
+
+    float* data() { return m_heights.data(); }
+    const float* data() const { return m_heights.data(); }
+    float* row(unsigned int z) { return m_heights.data() + index(0, z); }
+    const float* row(unsigned int z) const { return m_heights.data() + index(0, z); }
+
+    // World space position of a grid node, built on demand for meshing
+    ngl::Vec3 position(unsigned int x, unsigned int z) const {
+        return ngl::Vec3(x * m_spacing, at(x, z), z * m_spacing);
+    }
+
+private:
+    std::vector<float, AlignedAllocator<float, kAlignment>> m_heights;
+    unsigned int m_width = 0;
+    unsigned int m_depth = 0;
+    float m_spacing = 1.0f;
+};
+
+#endif //HEIGHTFIELD_H
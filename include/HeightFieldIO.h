@@ -0,0 +1,29 @@
+/**
+ * Writes height fields to disk for use outside the application.
+ * PGM files are 16 bit greyscale images normalised to the field's own height range,
+ * raw files are the heights as little endian float32, row by row.
+ */
+
+#ifndef HEIGHTFIELDIO_H
+#define HEIGHTFIELDIO_H
+
+#include <string>
+#include "HeightField.h"
+#include "TiledHeightField.h"
+
+// 16 bit binary PGM (P5), the lowest height maps to 0 and the highest to 65535
+bool writeHeightFieldPGM(const HeightField& heightField, const std::string& path);
+
+// Raw float32 heights, width * depth values without a header
+bool writeHeightFieldRaw(const HeightField& heightField, const std::string& path);
+
+// Picks the format from the extension: .pgm writes PGM, anything else raw float32
+bool writeHeightField(const HeightField& heightField, const std::string& path);
+
+// The same formats for a tiled field, streamed a band of tiles at a time so the whole field never
+// has to fit in memory. PGM reads the tiles twice, once for the height range.
+bool writeHeightFieldPGM(TiledHeightField& field, const std::string& path);
+bool writeHeightFieldRaw(TiledHeightField& field, const std::string& path);
+bool writeHeightField(TiledHeightField& field, const std::string& path);
+
+#endif //HEIGHTFIELDIO_H
@@ -7,10 +7,7 @@
  * terrain features like valleys, ridges, and river beds by simulating water flow.
  *
  * Performs hydraulic erosion simulation on the provided height grid
- * @param heightGrid - Reference to the grid of vertices to be eroded
- * @param width - Width of the grid in vertices
- * @param depth - Depth of the grid in vertices
- * @param spacing - Distance between grid vertices
+ * @param heightField - Height field to be eroded (width, depth and spacing come from the field)
  * @param numDroplets - Number of droplets to simulate
  * @param dropletMaxLifetime - Maximum number of steps for each droplet
  */
@@ -43,26 +40,63 @@ Sebastian Lague's Erosion outline: https://www.youtube.com/watch?v=eaXk97ujbPQ
 #define HYDRAULICEROSION_H
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include <ngl/Vec2.h>
 #include <ngl/Vec3.h>
 #include <ngl/Vec4.h>
+#include <cstdint>
+#include "CounterRandom.h"
+#include "DirtyTileMap.h"
+#include "ErosionModel.h"
+#include "HeightField.h"
+#include "ThermalErosion.h"
+#include "TrailBuffer.h"
+
+// Build with TERRAIN_RECORD_TRAILS=0 to compile trail recording out of the droplet loops
+#ifndef TERRAIN_RECORD_TRAILS
+#define TERRAIN_RECORD_TRAILS 1
+#endif
+
+// Droplets per packet in the batched kernel, one SIMD register of floats on the target
+#if defined(__AVX512F__)
+constexpr int kDropletLanes = 16;
+#else
+constexpr int kDropletLanes = 8;
+#endif
 
 struct HeightAndGradientData {
     float height = 0.0f;
     ngl::Vec2 rawGradientAscent{0.0f, 0.0f};
 };
 
-class HydraulicErosion {
+class HydraulicErosion : public ErosionModel {
 public:
     HydraulicErosion();
 
-    // Main method to perform erosion on a height grid
-    void erode(std::vector<ngl::Vec3>& heightGrid,
-               unsigned int width,
-               unsigned int depth,
-               float spacing,
+    // Main method to perform erosion on a height field, followed by the talus pass if enabled
+    void erode(HeightField& heightField,
                int numDroplets,
                int dropletMaxLifetime);
+    // ErosionModel entry point, runs numDroplets droplets of the default lifetime
+    void erode(HeightField& heightField, int numDroplets) override {
+        erode(heightField, numDroplets, m_dropletLifetime);
+    }
+    void setDropletLifetime(int lifetime) { m_dropletLifetime = std::max(1, lifetime); }
+    int getDropletLifetime() const { return m_dropletLifetime; }
+
+    // ErosionModel
+    const char* getName() const override { return "droplet"; }
+    std::unique_ptr<ErosionModel> clone() const override;
+    void setParameters(const ErosionParameters& parameters) override;
+    ErosionParameters getParameters() const override;
+    int getStepSize() const override { return kDropletsPerStep; }
+    // Droplets land per area, a region gets its share of them
+    int regionIterations(int iterations, double share) const override {
+        return static_cast<int>(std::lround(iterations * share));
+    }
+    // Clears the trail and restarts the droplet sequence
+    void reset() override;
 
     // Getters/setters for erosion parameters
     void setErosionRate(float rate) { m_erosionRate = rate; }
@@ -71,22 +105,139 @@ public:
     void setDepositionRate(float rate) { m_depositionRate = rate; }
     float getDepositionRate() const { return m_depositionRate; }
 
+    void setEvaporationRate(float rate) { m_evaporationRate = rate; }
+    float getEvaporationRate() const { return m_evaporationRate; }
+
+    // Parallel erosion: the grid is split into square tiles processed in four checkerboard phases,
+    // droplets are kept inside their tile plus a halo so concurrent brush footprints never overlap.
+    // A tile size of 0 keeps the original serial, unconfined simulation.
+    void setTileSize(int size) { m_tileSize = size; }
+    int getTileSize() const { return m_tileSize; }
+
+    // Worker threads used by the tiled path, 0 uses every hardware thread
+    void setThreadCount(unsigned int count) { m_threadCount = count; }
+    unsigned int getThreadCount() const { return m_threadCount; }
+
+    // Droplet start positions come from a counter based stream keyed by (seed, droplet index).
+    // The index keeps counting across erode() calls, so chunked runs continue the same sequence.
+    // Setting the seed restarts the sequence.
+    void setSeed(std::uint64_t seed) { m_random.setSeed(seed); m_dropletCounter = 0; }
+    std::uint64_t getSeed() const { return m_random.getSeed(); }
+    void resetDropletCounter() { m_dropletCounter = 0; }
+    // Continues the sequence from a copy that eroded elsewhere (e.g. on a worker thread)
+    void setDropletCounter(std::uint64_t counter) { m_dropletCounter = counter; }
+    std::uint64_t getDropletCounter() const { return m_dropletCounter; }
+
+    // Batched kernel: droplets advance in packets of kDropletLanes, with the per-step float math
+    // vectorised across lanes and the brush scatter done lane by lane. Droplets in a packet see
+    // each other's changes a step later, so results differ slightly from the one-at-a-time path.
+    void setBatchedSimulation(bool batched) { m_batchedSimulation = batched; }
+    bool isBatchedSimulation() const { return m_batchedSimulation; }
+
+    // Thermal clean up after the droplets: this many talus sweeps per kTalusDroplets droplets slump
+    // the spikes and pits they leave. Sweeps come due as droplets run and the remainder carries over
+    // to the next erode() call, so one big call and many small ones sweep the same number of times.
+    // 0 (the default) skips it. The pass uses this model's thread count.
+    static constexpr int kTalusDroplets = 1000;
+    void setTalusIterations(int iterations) { m_talusIterations = std::max(0, iterations); }
+    int getTalusIterations() const { return m_talusIterations; }
+    ThermalErosion& getTalusPass() { return m_talusPass; }
+    const ThermalErosion& getTalusPass() const { return m_talusPass; }
+
+    // Radius in cells of the erosion brush, the cached brush is rebuilt on the next erode() when it changes
+    void setErosionRadius(int radius) { m_erosionRadius = std::max(1, radius); }
+    int getErosionRadius() const { return m_erosionRadius; }
+
     // Additional parameter getters/setters...
 
     // Access to visualization data
-    const std::vector<ngl::Vec4>& getDropletTrailPoints() const { return m_dropletTrailPoints; }
+    const TrailBuffer& getDropletTrailPoints() const { return m_dropletTrailPoints; }
 
     void clearDropletTrailPoints() { m_dropletTrailPoints.clear(); }
-private:
-    // Helper methods
-    HeightAndGradientData getHeightAndGradient(const std::vector<ngl::Vec3>& heightGrid,
-                                              unsigned int width,
-                                              unsigned int depth,
-                                              float spacing,
+    void appendDropletTrailPoints(const TrailBuffer& points) { m_dropletTrailPoints.append(points); }
+
+    // Trail recording: off skips it at runtime (e.g. for bakes), sampling N records every Nth droplet.
+    // The trail is a ring of at most `capacity` points, the oldest are overwritten.
+    void setTrailRecording(bool record) { m_recordTrails = record; }
+    bool isTrailRecording() const { return m_recordTrails && TERRAIN_RECORD_TRAILS; }
+    void setTrailSampling(int everyNthDroplet) { m_trailSampling = std::max(1, everyNthDroplet); }
+    int getTrailSampling() const { return m_trailSampling; }
+    void setTrailCapacity(std::size_t points) { m_dropletTrailPoints.setCapacity(points); }
+    std::size_t getTrailCapacity() const { return m_dropletTrailPoints.getCapacity(); }
+
+    // Tiles changed by erode() since the last clearDirtyTiles(), so renderers can upload only those.
+    // Conservative: each droplet marks the box around every node it wrote to, brush included.
+    const DirtyTileMap& getDirtyTiles() const override { return m_dirtyTiles; }
+    void clearDirtyTiles() override { m_dirtyTiles.clear(); }
+
+    // Bilinear height and ascent gradient at a world position
+    HeightAndGradientData getHeightAndGradient(const HeightField& heightField,
                                               float worldX,
                                               float worldZ) const;
 
+    // Builds the brush stencil, cached until width, depth or radius change.
+    // erode() calls this itself, it is public so tools can prepare or benchmark it separately.
     void computeAreaOfInfluence(unsigned int width, unsigned int depth, float radius);
+private:
+    // Droplets per step(), also the worker's progress and cancel granularity
+    static constexpr int kDropletsPerStep = 1000;
+
+    // The droplet part of erode()
+    void simulateDroplets(HeightField& heightField, int numDroplets, int dropletMaxLifetime);
+
+    // Helper methods
+    // Grid cells a droplet may move through, max is exclusive
+    struct DropletBounds {
+        int minX;
+        int minZ;
+        int maxX;
+        int maxZ;
+    };
+
+    // Start position of a droplet and whether its trail is recorded
+    struct DropletStart {
+        ngl::Vec2 pos;
+        bool recordTrail;
+    };
+
+    // Runs a single droplet from its start position until it dies or leaves the bounds.
+    // trailPoints may be null when the droplet's trail isn't recorded.
+    void simulateDroplet(HeightField& heightField,
+                         ngl::Vec2 startPos,
+                         int dropletMaxLifetime,
+                         const DropletBounds& bounds,
+                         TrailBuffer* trailPoints,
+                         std::vector<GridRect>& dirtyRects);
+
+    // Runs up to kDropletLanes droplets in lockstep, the batched equivalent of simulateDroplet
+    void simulateDropletPacket(HeightField& heightField,
+                               const DropletStart* starts,
+                               int count,
+                               int dropletMaxLifetime,
+                               const DropletBounds& bounds,
+                               TrailBuffer& trailPoints,
+                               std::vector<GridRect>& dirtyRects);
+
+    // Bilinear sediment deposit on the four nodes around a world position
+    void depositSediment(HeightField& heightField, float worldX, float worldZ, float amountToDeposit) const;
+    // Removes up to amountToErode under the brush around a world position, adding it to sediment
+    void erodeBrush(HeightField& heightField, float worldX, float worldZ, float amountToErode, float& sediment) const;
+
+    // Nodes a droplet can have changed when it wrote between the given world positions
+    GridRect writeFootprint(const HeightField& heightField, float minWorldX, float minWorldZ,
+                            float maxWorldX, float maxWorldZ) const;
+
+    void markDirtyRects(const std::vector<GridRect>& rects);
+
+    void erodeTiled(HeightField& heightField,
+                    int numDroplets,
+                    int dropletMaxLifetime);
+
+    // Grid cell a droplet starts in, drawn from the counter based stream
+    void dropletStartCell(std::uint64_t dropletIndex, unsigned int width, unsigned int depth, int& gridX, int& gridZ) const;
+    bool recordsTrail(std::uint64_t dropletIndex) const {
+        return TERRAIN_RECORD_TRAILS && m_recordTrails && dropletIndex % static_cast<std::uint64_t>(m_trailSampling) == 0;
+    }
 
     // Droplet structure
     struct Droplet {
@@ -116,11 +267,42 @@ private:
     float m_depositionRadius = 3.0;
     float m_maxErosionDepthFactor = 0.5f;
     float m_friction = 0.0f;
+    int m_dropletLifetime = 30;
+
+    // Thermal post-process
+    ThermalErosion m_talusPass;
+    int m_talusIterations = 0;
+    // Droplets times sweeps not yet swept for, less than kTalusDroplets
+    std::int64_t m_talusBacklog = 0;
+
+    // Parallel settings
+    int m_tileSize = 0;
+    unsigned int m_threadCount = 0;
+    bool m_batchedSimulation = false;
+
+    // Reproducible droplet placement
+    CounterRandom m_random{0x5EED};
+    std::uint64_t m_dropletCounter = 0;
+
+    // Changed tiles, and the per droplet footprints collected during one erode() call
+    DirtyTileMap m_dirtyTiles;
+    std::vector<GridRect> m_dirtyRects;
 
     // Data structures
-    std::vector<ngl::Vec4> m_dropletTrailPoints;
-    std::vector<std::vector<int>> m_brushIndices;
-    std::vector<std::vector<float>> m_brushWeights;
+    TrailBuffer m_dropletTrailPoints;
+    bool m_recordTrails = true;
+    int m_trailSampling = 1;
+    // Erosion brush stencil shared by every cell: offsets from the droplet's cell and normalised weights.
+    // Cells closer than m_brushExtent to the border skip the offsets that fall off the grid.
+    std::vector<int> m_brushOffsetX;
+    std::vector<int> m_brushOffsetZ;
+    std::vector<float> m_brushWeights;
+    std::vector<int> m_brushIndexOffsets; // offsetZ * width + offsetX for the cached width
+    int m_brushExtent = 0;
+    // Cache key of the stencil above
+    float m_brushRadius = 0.0f;
+    unsigned int m_brushWidth = 0;
+    unsigned int m_brushDepth = 0;
 };
 
 
@@ -11,6 +11,9 @@
 #include <QSet>
 #include <ngl/Text.h>
 #include "Plane.h"
+#include "ErosionWorker.h"
+
+class QThread;
 //----------------------------------------------------------------------------------------------------------------------
 /// @file NGLScene.h
 /// @brief this class inherits from the Qt OpenGLWindow and allows us to use NGL to draw OpenGL
@@ -56,7 +59,17 @@ class NGLScene : public QOpenGLWidget
     void updateGridWidth(int width);
     void updateGridDepth(int depth);
     void updateTerrainHeight(int height);
-    void callErosionEvent(int totalDroplets, int lifetime);
+    void updateTerrainSeed(int seed);
+    // Starts erosion on a worker thread, a run already in progress is cancelled and kept first.
+    // iterations are droplets or time steps depending on the model, lifetime only applies to droplets.
+    void callErosionEvent(int iterations, int lifetime);
+    // 0 = droplets (HydraulicErosion), 1 = virtual pipes (ShallowWaterErosion), 2 = talus only (ThermalErosion)
+    void updateErosionModel(int index);
+    // Runs most of the erosion on a coarser grid first (PyramidErosion), kept across model switches
+    void updateErosionPyramid(bool enabled);
+    // Stops the running erosion, keeping whatever it finished so far
+    void cancelErosion();
+    bool isEroding() const { return m_erosionThread != nullptr; }
 
 
 public slots :
@@ -65,6 +78,12 @@ public slots :
 
 signals :
     void glInitialized();
+    void erosionProgress(int iterationsDone, int totalIterations);
+    void erosionRunningChanged(bool running);
+
+private slots:
+    void applyErosionSnapshot();
+    void erosionFinished();
 
 private:
 
@@ -101,6 +120,10 @@ private:
     void timerEvent(QTimerEvent *_event) override;
     void keyReleaseEvent(QKeyEvent *_event) override;
     void process_keys();
+    // Cancels the worker and waits for it, the terrain only keeps its result when keepResult is set
+    void stopErosion(bool keepResult);
+    // The GUI's erosion settings, applied to every model the plane is given
+    void configureErosion();
     /// @brief windows parameters for mouse control etc.
     WinParams m_win;
     /// position for our model
@@ -108,6 +131,12 @@ private:
     std::unique_ptr<DropletVisualize> m_emitter;
     std::unique_ptr<Plane> m_plane;
     std::unique_ptr<HydraulicErosion> m_erode;
+    // Background erosion, both null when idle
+    QThread* m_erosionThread = nullptr;
+    ErosionWorker* m_erosionWorker = nullptr;
+    // Receives the worker's snapshots, its buffers are swapped back and forth with the Plane
+    ErosionSnapshot m_erosionSnapshot;
+    bool m_erosionPyramid = false;
     bool m_animate = true;
     bool m_wireframeMode = false;
 
@@ -0,0 +1,44 @@
+/**
+ * Minimal fork/join helper used by the simulation code.
+ * Spreads the indices [0, count) over the shared ThreadPool, whose threads pull work
+ * from an atomic counter, and returns once every index is done.
+ */
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+#include "ThreadPool.h"
+
+// Resolves a user facing thread count, 0 means "use every hardware thread"
+inline unsigned int resolveThreadCount(unsigned int requested)
+{
+    if (requested != 0) { return requested; }
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware == 0 ? 1 : hardware;
+}
+
+// Calls func(index) for every index in [0, count) using up to threadCount threads.
+// The calling thread takes part in the work, so threadCount == 1 never touches the pool.
+template <typename Func>
+void parallelFor(std::size_t count, unsigned int threadCount, Func&& func)
+{
+    if (count == 0) { return; }
+
+    std::size_t workers = std::min<std::size_t>(resolveThreadCount(threadCount), count);
+    if (workers <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i) { func(i); }
+        return;
+    }
+
+    using Body = std::remove_reference_t<Func>;
+    ThreadPool::shared().run(count, static_cast<unsigned int>(workers),
+                             [](void* body, std::size_t i) { (*static_cast<Body*>(body))(i); },
+                             const_cast<void*>(static_cast<const void*>(&func)));
+}
+
+#endif //PARALLELFOR_H
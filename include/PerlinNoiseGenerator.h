@@ -1,18 +1,31 @@
  /**
  * Implements the TerrainGenerator interface to create natural-looking terrain
 * using Perlin noise algorithms with configurable frequency and octaves.
+* The unscaled fBm sums are cached per octave count, so a height change is only a rescale
+* and adding or removing octaves only computes the octaves that differ.
 */
 
 #ifndef PERLINNOISEGENERATOR_H
 #define PERLINNOISEGENERATOR_H
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
 #include "TerrainGenerator.h"
+#include "PerlinNoise.hpp"
 
 
 class PerlinNoiseGenerator : public TerrainGenerator {
 public:
-    PerlinNoiseGenerator(float frequency = 3.0f, int octaves = 6, int maxHeight = 90);
+    static constexpr std::uint32_t kDefaultSeed = 123456u;
 
-    void generateTerrain(std::vector<ngl::Vec3>& heightGrid, unsigned int width, unsigned int depth, float spacing, int maxHeight) override;
+    PerlinNoiseGenerator(float frequency = 3.0f, int octaves = 6, int maxHeight = 90,
+                         std::uint32_t seed = kDefaultSeed);
+
+    void generateTerrain(HeightField& heightField, int maxHeight) override;
+    // Evaluates every octave, the octave cache only covers whole grids
+    void generateRegion(HeightField& heightField, unsigned int originX, unsigned int originZ,
+                        unsigned int worldWidth, unsigned int worldDepth, int maxHeight) override;
 
 
 
@@ -25,9 +38,45 @@ public:
 
     int getMaxHeight() const { return m_maxHeight; }
 
+    // Shuffles the permutation table only when the seed actually changes,
+    // regenerating with the same seed reuses the current noise state
+    void setSeed(std::uint32_t seed);
+    std::uint32_t getSeed() const { return m_seed; }
+
+    // Rows are generated in parallel bands, 0 uses every hardware thread. The result doesn't depend on it
+    void setThreadCount(unsigned int count) { m_threadCount = count; }
+    unsigned int getThreadCount() const { return m_threadCount; }
+
+    // Memory for cached octave sums (one double per vertex per octave count), 0 turns the cache off.
+    // The sum for the current octave count is kept first, then the counts closest to it.
+    static constexpr std::size_t kDefaultOctaveCacheBudget = 256u << 20;
+    void setOctaveCacheBudget(std::size_t bytes);
+    std::size_t getOctaveCacheBudget() const { return m_octaveCacheBudget; }
+    std::size_t getCachedOctaveLayers() const { return m_octaveLayers.size(); }
+
 private:
+    // Drops the cached sums when the grid, frequency or seed no longer match
+    void validateOctaveCache(unsigned int width, unsigned int depth, float spacing);
+    // Octave counts worth keeping after generating octaves, from existing and newly summed layers
+    std::vector<int> chooseOctaveLayers(int octaves, int firstNew, std::size_t cells) const;
+
+    // Rows per parallelFor task, enough to amortise the scheduling and the scratch row
+    static constexpr unsigned int kRowsPerTask = 16;
+
     float m_frequency;
     int m_octaves;
     int m_maxHeight;
+    unsigned int m_threadCount = 0;
+    std::uint32_t m_seed;
+    siv::PerlinNoise m_perlin;
+
+    // Sum of the first n octaves of octave2D for every vertex, keyed by n
+    std::map<int, std::vector<double>> m_octaveLayers;
+    std::size_t m_octaveCacheBudget = kDefaultOctaveCacheBudget;
+    unsigned int m_cacheWidth = 0;
+    unsigned int m_cacheDepth = 0;
+    float m_cacheSpacing = 0.0f;
+    float m_cacheFrequency = 0.0f;
+    std::uint32_t m_cacheSeed = 0;
 };
 #endif //PERLINNOISEGENERATOR_H
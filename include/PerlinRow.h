@@ -0,0 +1,29 @@
+/**
+ * Batched evaluation of siv::PerlinNoise over a row of points that share one y coordinate.
+ * Points are processed kNoiseLanes at a time with the Fade/Lerp/Grad math written as straight
+ * lane loops the compiler turns into SIMD, and everything that only depends on y is worked out
+ * once per octave instead of once per point. Results are bit-identical to the scalar
+ * noise2D()/octave2D() calls.
+ */
+
+#ifndef PERLINROW_H
+#define PERLINROW_H
+
+#include "PerlinNoise.hpp"
+
+// Points per batch, two AVX2 (one AVX-512) registers of doubles
+constexpr int kNoiseLanes = 8;
+
+// out[i] = perlin.noise2D(x[i], y)
+void noise2DRow(const siv::PerlinNoise& perlin, const double* x, double y, int count, double* out);
+
+// out[i] = perlin.octave2D(x[i], y, octaves, persistence)
+void octave2DRow(const siv::PerlinNoise& perlin, const double* x, double y, int count,
+                 int octaves, double persistence, double* out);
+
+// Adds octaves [firstOctave, firstOctave + octaveCount) of octave2D to out. Starting from the
+// sum of the first firstOctave octaves this gives the same bits as computing them all at once.
+void addOctaves2DRow(const siv::PerlinNoise& perlin, const double* x, double y, int count,
+                     int firstOctave, int octaveCount, double persistence, double* out);
+
+#endif //PERLINROW_H
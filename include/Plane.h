@@ -4,26 +4,51 @@
 #include <vector>
 #include <ngl/Vec3.h>
 #include <memory>
+#include <cstdint>
 #include <ngl/MultiBufferVAO.h>
+#include <ngl/Mat4.h>
 #include <ngl/Vec2.h>
+#include "DirtyTileMap.h"
+#include "ErosionModel.h"
+#include "HeightField.h"
 #include "HydraulicErosion.h"
 #include "TerrainGenerator.h"
+#include "TerrainLOD.h"
 #include "PerlinNoiseGenerator.h"
 
+// What the terrain vertex buffer holds per grid node
+enum class TerrainVertexFormat {
+    Position, // full ngl::Vec3, drawn with HeightColourShader
+    Height    // one float, x/z rebuilt in HeightGridShader from the vertex index
+};
+
 /**
  * Manages terrain mesh generation and rendering
  * Handles the creation, modification, and rendering of a 3D terrain mesh.
- * Uses the Strategy pattern for terrain generation and delegates erosion to HydraulicErosion.
+ * Uses the Strategy pattern for terrain generation and erosion (TerrainGenerator and ErosionModel).
  */
 
 class Plane
 {
 public:
     Plane(unsigned int _width, unsigned int _depth, float _spacing = 10.0f);
+    ~Plane();
     void generate();
     void regenerate();
     void render() const;
+    // Draws the chunks TerrainLOD picks for this eye position and MVP (both in the terrain's model space)
+    void renderLOD(const ngl::Vec3& eye, const ngl::Mat4& modelViewProjection);
     void refreshGPUAssets();
+    // Uploads only the dirty tiles of the height grid, falls back to refreshGPUAssets() when the layout changed
+    void refreshGPUTiles(const DirtyTileMap& dirtyTiles);
+    // Switching format rebuilds the vertex buffer, so it needs a current GL context
+    void setVertexFormat(TerrainVertexFormat format);
+    TerrainVertexFormat getVertexFormat() const { return m_vertexFormat; }
+    // Chunked level of detail, switching swaps the index buffer so it needs a current GL context
+    void setLodEnabled(bool enabled);
+    bool isLodEnabled() const { return m_lodEnabled; }
+    std::size_t getLodTriangles() const { return m_lod.getSelectedTriangles(); }
+    float getSpacing() const { return m_spacing; }
     void setTerrainGenerator(std::shared_ptr<TerrainGenerator> generator) {
         m_terrainGenerator = generator;
     }
@@ -57,38 +82,118 @@ public:
         if(perlinGen) perlinGen->setOctaves(oct);
     }
 
+    /**
+ * Updates the noise seed and propagates to terrain generator
+ * Changes take effect on next regenerate() call
+ */
+    void setNoiseSeed(std::uint32_t seed) {
+        m_noiseSeed = seed;
+        auto perlinGen = std::dynamic_pointer_cast<PerlinNoiseGenerator>(m_terrainGenerator);
+        if(perlinGen) perlinGen->setSeed(seed);
+    }
+    std::uint32_t getNoiseSeed() const { return m_noiseSeed; }
+
     //Erosion
-    void applyHydraulicErosion(int numDroplets, int dropletMaxLifetime /*, other params */);
-    // Delegate access to droplet trailpoitns
-    const std::vector<ngl::Vec4>& getDropletTrailPoints() const { return m_erosion.getDropletTrailPoints(); }
+    // Swaps the erosion strategy, the next erode uses the new model on the current terrain
+    void setErosionModel(std::shared_ptr<ErosionModel> model);
+    const ErosionModel& getErosionModel() const { return *m_erosionModel; }
+    // Runs `iterations` units of the current model (droplets or time steps) on the terrain
+    void applyErosion(int iterations);
+    // Wraps the current model in a PyramidErosion of `levels` coarse levels, 0 unwraps it again
+    void setErosionPyramid(int levels);
+    // Erosion threads for any model. The tile size only applies to the droplet model, 0 runs droplets serially
+    void setErosionThreading(unsigned int threads, int tileSize);
+    // Droplet model only: advance droplets in SIMD packets instead of one at a time
+    void setErosionBatched(bool batched) {
+        HydraulicErosion* droplets = dropletModel();
+        if(droplets) {
+            droplets->setBatchedSimulation(batched);
+            markErosionModelChanged();
+        }
+    }
+    // Droplet model only: maximum steps per droplet
+    void setDropletLifetime(int lifetime) {
+        HydraulicErosion* droplets = dropletModel();
+        if(droplets) {
+            droplets->setDropletLifetime(lifetime);
+            markErosionModelChanged();
+        }
+    }
+    // Droplet model only: talus sweeps per 1000 droplets to slump droplet spikes (0 = off), see ThermalErosion
+    void setErosionTalus(int iterations, float slope) {
+        HydraulicErosion* droplets = dropletModel();
+        if(droplets) {
+            droplets->setTalusIterations(iterations);
+            droplets->getTalusPass().setTalusSlope(slope);
+            markErosionModelChanged();
+        }
+    }
+    // Droplet model only: seed for droplet placement, the same seed and droplet count give the same terrain
+    void setErosionSeed(std::uint64_t seed) {
+        HydraulicErosion* droplets = dropletModel();
+        if(droplets) {
+            droplets->setSeed(seed);
+            markErosionModelChanged();
+        }
+    }
+    // Copies for background erosion (see ErosionWorker)
+    const HeightField& getHeightField() const { return m_heightGrid; }
+    // Takes over a height field eroded elsewhere by swapping buffers, heightField receives the old grid.
+    // For the droplet model new trail points are appended and the droplet sequence continues from
+    // dropletCounter. Only the dirty tiles are uploaded.
+    void applyErosionSnapshot(HeightField& heightField,
+                              const TrailBuffer& newTrailPoints,
+                              std::uint64_t dropletCounter,
+                              const DirtyTileMap& dirtyTiles);
+    // Delegate access to droplet trailpoitns, empty for models without droplets
+    const TrailBuffer& getDropletTrailPoints() const;
 private:
 
     // Helper methods for generation
     void clearTerrainData();
     void createBaseGridVertices();
-    void buildTriangleMeshFromGrid(const std::vector<ngl::Vec3>& noisyGridVertices);
+    void buildTriangleMeshFromGrid(const HeightField& heightField);
     void setupTerrainVAO();
+    void releaseIndexBuffer();
+    // The droplet model doing the full resolution work, also inside a pyramid, null for other models
+    HydraulicErosion* dropletModel();
+    const HydraulicErosion* dropletModel() const;
+    // After a droplet setting changed: a pyramid's coarse copy has the old one
+    void markErosionModelChanged();
+    // Index buffer contents for the current mode, the full grid or the LOD pool
+    const std::vector<std::uint32_t>& activeIndices() const { return m_lodEnabled ? m_lod.getIndices() : m_indices; }
 
 
     unsigned int m_width;
     unsigned int m_depth;
-    std::vector<ngl::Vec3> m_verticesRaw; // grid vertices
-    std::vector<ngl::Vec3> m_vertices;    // triangle vertices (duplicated)
-    std::vector<GLuint> m_indices;
-    std::vector<ngl::Vec3> m_heightGrid;
+    std::vector<ngl::Vec3> m_vertices;    // one vertex per grid node, Position format only
+    std::vector<std::uint32_t> m_indices; // two triangles per cell, cached until the grid size changes
+    unsigned int m_indexWidth = 0;
+    unsigned int m_indexDepth = 0;
+    bool m_layoutChanged = false;         // indices or vertex format differ from what is on the GPU
+    TerrainVertexFormat m_vertexFormat = TerrainVertexFormat::Height;
+
+    bool m_lodEnabled = false;
+    TerrainLOD m_lod;
+    std::vector<ChunkDraw> m_lodDraws;
+    HeightField m_heightGrid;
     float m_spacing;
 
     // Rendering
     std::unique_ptr<ngl::MultiBufferVAO> m_vao;
+    GLuint m_indexBuffer = 0;
 
 
     float m_noiseFrequency = 3.0f;
     int m_noiseOctaves = 6;
+    std::uint32_t m_noiseSeed = PerlinNoiseGenerator::kDefaultSeed;
     int m_maxHeight = 90;
 
     std::shared_ptr<TerrainGenerator> m_terrainGenerator;
 
-    HydraulicErosion m_erosion;
+    std::shared_ptr<ErosionModel> m_erosionModel;
+    // Handed out as the trail when the model has none, zero capacity so renderers drop their copy
+    TrailBuffer m_noTrailPoints{0};
 };
 
 #endif // PLANE_H
@@ -0,0 +1,96 @@
+/**
+ * Coarse to fine erosion around any other ErosionModel.
+ *
+ * erode() box filters the height field down by 2^levels, runs most of the iterations on that
+ * coarse grid, adds the bilinearly upsampled height change back onto the full grid, and then runs
+ * the remaining iterations on the full grid to put back the small scale detail. Large scale valley
+ * structure costs a fraction of a full resolution run, since a coarse droplet or time step covers
+ * 4^levels nodes. Iterations keep the wrapped model's units, full resolution droplets or time steps;
+ * ErosionModel::coarseIterations says how many the coarse grid needs for the same effect, 4^levels
+ * times fewer droplets or sweeps, as many pipe time steps.
+ *
+ * The wrapped model does the full resolution work and keeps its trails, dirty tiles and settings,
+ * the coarse level runs a copy of it made on the first erode. The copy is made again after the
+ * wrapped model's settings may have changed, and droplet models share one droplet counter, so
+ * coarse droplets carry on from the full resolution sequence instead of repeating it. Copies of
+ * the pyramid copy both.
+ */
+
+#ifndef PYRAMIDEROSION_H
+#define PYRAMIDEROSION_H
+
+#include <algorithm>
+#include <memory>
+#include "ErosionModel.h"
+
+class PyramidErosion : public ErosionModel {
+public:
+    // Takes the model shared so a caller can unwrap it again without copying its state
+    explicit PyramidErosion(std::shared_ptr<ErosionModel> model, int levels = kDefaultLevels);
+    PyramidErosion(const PyramidErosion& other);
+    PyramidErosion& operator=(const PyramidErosion&) = delete;
+
+    void erode(HeightField& heightField, int iterations) override;
+
+    // ErosionModel, parameters are the wrapped model's
+    const char* getName() const override { return "pyramid"; }
+    std::unique_ptr<ErosionModel> clone() const override;
+    void setParameters(const ErosionParameters& parameters) override;
+    ErosionParameters getParameters() const override { return m_model->getParameters(); }
+    // Steps are 4^levels of the wrapped model's, so each one has coarse work to do
+    int getStepSize() const override { return m_model->getStepSize() << (2 * m_levels); }
+    void reset() override;
+    // Settles the coarse copy's state through its upsampled change, then the wrapped model's
+    void settle(HeightField& heightField) override;
+    int coarseIterations(int iterations, int factor) const override { return m_model->coarseIterations(iterations, factor); }
+    int regionIterations(int iterations, double share) const override { return m_model->regionIterations(iterations, share); }
+
+    // Every node can change on the coarse pass, so each erode marks the whole grid
+    const DirtyTileMap& getDirtyTiles() const override { return m_dirtyTiles; }
+    void clearDirtyTiles() override;
+
+    // Halvings of the grid for the coarse pass, 0 runs the wrapped model alone
+    void setLevels(int levels) { m_levels = std::clamp(levels, 0, kMaxLevels); m_coarseModel.reset(); }
+    int getLevels() const { return m_levels; }
+    // Share of the iterations run at full resolution, the rest goes to the coarse pass
+    void setRefineFraction(float fraction) { m_refineFraction = std::clamp(fraction, 0.0f, 1.0f); }
+    float getRefineFraction() const { return m_refineFraction; }
+
+    // The full resolution model, for its model specific settings. Call markModelChanged() after
+    // changing them, the coarse copy was made with the old ones.
+    ErosionModel& getModel() { return *m_model; }
+    const ErosionModel& getModel() const { return *m_model; }
+    // The coarse copy settles and is made again from the model on the next erode
+    void markModelChanged() { m_modelChanged = true; }
+    const std::shared_ptr<ErosionModel>& getSharedModel() const { return m_model; }
+
+    // The model doing the full resolution work: the wrapped one for a pyramid, otherwise model itself
+    static ErosionModel& fullResolutionModel(ErosionModel& model);
+    static const ErosionModel& fullResolutionModel(const ErosionModel& model);
+
+    static constexpr int kDefaultLevels = 2;
+    static constexpr int kMaxLevels = 4;
+
+private:
+    // Rows per parallelFor task
+    static constexpr unsigned int kRowsPerTask = 16;
+
+    // Box filters fine into m_coarse, nodes past the last full block average what is there
+    void downsample(const HeightField& fine);
+    // Adds the bilinear upsampling of m_coarse - m_coarseStart to fine
+    void addUpsampledChange(HeightField& fine) const;
+    // Puts what the coarse copy still carries onto fine and drops the copy
+    void settleCoarse(HeightField& fine);
+
+    std::shared_ptr<ErosionModel> m_model;
+    std::unique_ptr<ErosionModel> m_coarseModel; // copy of m_model, made on the first erode
+    bool m_modelChanged = false;                  // m_coarseModel may have stale settings
+    int m_levels;
+    float m_refineFraction = 0.2f;
+
+    HeightField m_coarse;
+    HeightField m_coarseStart;
+    DirtyTileMap m_dirtyTiles;
+};
+
+#endif //PYRAMIDEROSION_H
@@ -0,0 +1,23 @@
+/**
+ * Helper for stencil passes over one row of a grid, shared by the grid erosion models.
+ * The first and last columns are split off from the interior, so the interior loop sees
+ * constant neighbour flags and compiles to branch free code the compiler can vectorise.
+ */
+
+#ifndef ROWSTENCIL_H
+#define ROWSTENCIL_H
+
+#include <cstddef>
+
+// Calls cell(x, hasLeft, hasRight) for every x in [0, width), width must be at least 2
+template <typename Cell>
+inline void forRowCells(std::size_t width, Cell&& cell)
+{
+    cell(std::size_t{0}, false, true);
+    for (std::size_t x = 1; x + 1 < width; ++x) {
+        cell(x, true, true);
+    }
+    cell(width - 1, true, false);
+}
+
+#endif //ROWSTENCIL_H
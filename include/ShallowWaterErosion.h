@@ -0,0 +1,120 @@
+/**
+ * Grid based hydraulic erosion with the virtual pipe shallow water model of
+ * Mei, Decaudin and Hu, "Fast Hydraulic Erosion Simulation and Visualization on GPU" (2007).
+ *
+ * Every cell holds water, suspended sediment and the outflow through four virtual pipes to
+ * its neighbours. One time step is a fixed sequence of whole grid passes:
+ *   rain -> outflow flux -> water and velocity -> erosion/deposition -> sediment transport + evaporation
+ * Sediment is carried through the same pipes as the water, so it is conserved.
+ * Each pass only writes its own cell and reads the previous pass's fields, so the rows of a pass
+ * run in parallel bands, the result doesn't depend on the thread count, and the inner loops over a
+ * row are plain float math on separate arrays. Cost per step is fixed by the grid size.
+ */
+
+#ifndef SHALLOWWATEREROSION_H
+#define SHALLOWWATEREROSION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "ErosionModel.h"
+
+class ShallowWaterErosion : public ErosionModel {
+public:
+    // Runs `steps` time steps. Water, sediment and flux carry over between calls on the same grid size.
+    void erode(HeightField& heightField, int steps) override;
+    // Drops all water and sediment, e.g. for a new terrain. Suspended sediment is lost, not deposited.
+    void reset() override;
+    // Deposits the suspended sediment where it is and drops the water
+    void settle(HeightField& heightField) override;
+
+    // ErosionModel, erosionRate maps to the dissolving rate
+    const char* getName() const override { return "pipe"; }
+    std::unique_ptr<ErosionModel> clone() const override;
+    void setParameters(const ErosionParameters& parameters) override;
+    ErosionParameters getParameters() const override;
+    int getStepSize() const override { return kTimeStepsPerStep; }
+    // A time step covers the same stretch of time on any grid, water needs as many to get anywhere
+    int coarseIterations(int iterations, int /*factor*/) const override { return iterations; }
+
+    const DirtyTileMap& getDirtyTiles() const override { return m_dirtyTiles; }
+    void clearDirtyTiles() override { m_dirtyTiles.clear(); }
+
+    // Simulation parameters, rates are per unit of simulated time
+    void setTimeStep(float dt) { m_timeStep = dt; }
+    float getTimeStep() const { return m_timeStep; }
+    void setRainRate(float rate) { m_rainRate = rate; }
+    float getRainRate() const { return m_rainRate; }
+    void setEvaporationRate(float rate) { m_evaporationRate = rate; }
+    float getEvaporationRate() const { return m_evaporationRate; }
+    void setSedimentCapacity(float capacity) { m_sedimentCapacity = capacity; }
+    float getSedimentCapacity() const { return m_sedimentCapacity; }
+    void setDissolvingRate(float rate) { m_dissolvingRate = rate; }
+    float getDissolvingRate() const { return m_dissolvingRate; }
+    void setDepositionRate(float rate) { m_depositionRate = rate; }
+    float getDepositionRate() const { return m_depositionRate; }
+    // Water depth from which a cell reaches its full transport capacity, shallower cells carry proportionally less
+    void setMaxErosionDepth(float depth) { m_maxErosionDepth = std::max(1e-4f, depth); }
+    float getMaxErosionDepth() const { return m_maxErosionDepth; }
+    // Lower bound on the slope term, so flat cells still carry some sediment
+    void setMinTilt(float tilt) { m_minTilt = tilt; }
+    float getMinTilt() const { return m_minTilt; }
+
+    // Worker threads for the grid passes, 0 uses every hardware thread
+    void setThreadCount(unsigned int count) { m_threadCount = count; }
+    unsigned int getThreadCount() const { return m_threadCount; }
+
+    // Current state, one value per grid node (empty before the first erode)
+    const std::vector<float>& getWater() const { return m_water; }
+    const std::vector<float>& getSediment() const { return m_sediment; }
+
+private:
+    // Rows per parallelFor task
+    static constexpr unsigned int kRowsPerTask = 16;
+    // Time steps per step(), also the worker's progress and cancel granularity
+    static constexpr int kTimeStepsPerStep = 2;
+
+    // Matches the fields to the grid, clearing them when the size changes
+    void resize(unsigned int width, unsigned int depth);
+    void simulateStep(HeightField& heightField);
+
+    // Runs pass(firstRow, lastRow) over all rows in parallel bands
+    template <typename Pass>
+    void forRowBands(unsigned int depth, Pass&& pass) const;
+
+    void updateFlux(const HeightField& heightField, unsigned int firstRow, unsigned int lastRow);
+    void updateWaterAndVelocity(const HeightField& heightField, unsigned int firstRow, unsigned int lastRow);
+    void erodeAndDeposit(HeightField& heightField, unsigned int firstRow, unsigned int lastRow);
+    void transportSediment(const HeightField& heightField, unsigned int firstRow, unsigned int lastRow);
+
+    float m_timeStep = 0.02f;
+    float m_rainRate = 0.012f;
+    float m_evaporationRate = 0.015f;
+    float m_gravity = 9.81f;
+    float m_pipeArea = 1.0f;
+    float m_sedimentCapacity = 0.1f;
+    float m_dissolvingRate = 0.5f;
+    float m_depositionRate = 1.0f;
+    float m_minTilt = 0.05f;
+    float m_maxErosionDepth = 1.0f;
+    unsigned int m_threadCount = 0;
+
+    unsigned int m_width = 0;
+    unsigned int m_depth = 0;
+    // Structure of arrays, one entry per grid node
+    std::vector<float> m_water;
+    std::vector<float> m_waterStart; // water at the start of the step, rain included
+    std::vector<float> m_sediment;
+    std::vector<float> m_sedimentNext;
+    std::vector<float> m_fluxLeft;
+    std::vector<float> m_fluxRight;
+    std::vector<float> m_fluxUp;    // towards z - 1
+    std::vector<float> m_fluxDown;  // towards z + 1
+    std::vector<float> m_velocityX;
+    std::vector<float> m_velocityZ;
+    std::vector<float> m_capacity;  // transport capacity, worked out before the heights change
+
+    DirtyTileMap m_dirtyTiles;
+};
+
+#endif //SHALLOWWATEREROSION_H
@@ -5,14 +5,18 @@
 #ifndef TERRAINGENERATOR_H
 #define TERRAINGENERATOR_H
 
-#include <vector>
-#include <ngl/Vec3.h>
+#include "HeightField.h"
 
 class TerrainGenerator {
 public:
     virtual ~TerrainGenerator() = default;
 
-    virtual void generateTerrain(std::vector<ngl::Vec3>& heightGrid, unsigned int width, unsigned int depth, float spacing, int maxHeight) = 0;
+    // Fills every height of the field, grid size and spacing are taken from the field itself
+    virtual void generateTerrain(HeightField& heightField, int maxHeight) = 0;
+    // Fills heightField with the part of a worldWidth x worldDepth terrain starting at node (originX, originZ),
+    // the same heights generateTerrain gives those nodes on the whole grid. For terrains generated tile by tile.
+    virtual void generateRegion(HeightField& heightField, unsigned int originX, unsigned int originZ,
+                                unsigned int worldWidth, unsigned int worldDepth, int maxHeight) = 0;
 
 };
 
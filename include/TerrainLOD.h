@@ -0,0 +1,117 @@
+/**
+ * Chunked level of detail for the terrain (geomipmapping).
+ * The grid is split into chunks of kChunkQuads x kChunkQuads cells, the ones along the far edges
+ * cut short by the grid border. Each chunk can be drawn every 2^lod nodes (a chunk cut short ends
+ * in a narrower row and column of cells); the index lists for every chunk size, LOD and edge
+ * combination are built once per grid size into one pool, indexed relative to the chunk's first vertex so a chunk is drawn
+ * with glDrawElementsBaseVertex. Every frame select() picks each chunk's LOD from its distance
+ * to the eye, keeps neighbours within one LOD of each other and culls chunks outside the
+ * frustum. No GL here, so the selection can be checked on the CPU.
+ *
+ * Cracks between LODs are closed on the coarser side: a chunk whose neighbour is one LOD finer
+ * draws the cells along that edge as fans through the cell centre that include the finer
+ * neighbour's extra edge vertices.
+ */
+
+#ifndef TERRAINLOD_H
+#define TERRAINLOD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "HeightField.h"
+
+// View frustum as six planes (a, b, c, d), inside where a*x + b*y + c*z + d >= 0
+struct Frustum {
+    float planes[6][4];
+
+    // Planes of a column major (OpenGL / ngl::Mat4 layout) model view projection matrix,
+    // the frustum is then in the model's space
+    static Frustum fromMatrix(const float* matrix);
+    // False only when the box is completely outside one of the planes
+    bool intersectsBox(const ngl::Vec3& boxMin, const ngl::Vec3& boxMax) const;
+};
+
+// One chunk to draw: a range of the index pool and the vertex it is relative to
+struct ChunkDraw {
+    std::size_t firstIndex = 0;
+    std::size_t indexCount = 0;
+    std::uint32_t baseVertex = 0;
+    int lod = 0;
+};
+
+class TerrainLOD {
+public:
+    static constexpr int kChunkQuads = 64;
+    static constexpr int kMaxLod = 6; // 2^6 = kChunkQuads, a whole chunk as two triangles
+
+    // Edge bits of the stitching masks: the neighbour on that side is one LOD finer
+    enum Edge : unsigned int { kNorth = 1, kEast = 2, kSouth = 4, kWest = 8 };
+
+    // Lays out the chunks and builds the index pool. Returns true when anything was rebuilt,
+    // which only happens when width or depth change.
+    bool setGrid(unsigned int width, unsigned int depth, float spacing);
+    // Recomputes the height range of the chunks overlapping region (all chunks by default)
+    void updateBounds(const HeightField& heightField);
+    void updateBounds(const HeightField& heightField, const GridRect& region);
+
+    // Distance at which chunks drop from LOD 0 to 1, each doubling drops one more LOD
+    void setLodDistance(float distance) { m_lodDistance = distance; }
+    float getLodDistance() const { return m_lodDistance; }
+
+    // Picks the chunks to draw for an eye position and model view projection matrix, both in
+    // the terrain's model space. draws is refilled, its capacity is reused between frames.
+    void select(const ngl::Vec3& eye, const float* modelViewProjection, std::vector<ChunkDraw>& draws);
+
+    const std::vector<std::uint32_t>& getIndices() const { return m_indices; }
+    int getChunksX() const { return m_chunksX; }
+    int getChunksZ() const { return m_chunksZ; }
+    // LOD of a chunk from the last select(), culled chunks included
+    int getChunkLod(int chunkX, int chunkZ) const { return m_chunks[chunkZ * m_chunksX + chunkX].lod; }
+    std::size_t getSelectedTriangles() const { return m_selectedTriangles; }
+
+private:
+    struct IndexRange {
+        std::size_t first = 0;
+        std::size_t count = 0;
+    };
+
+    // Index lists of one chunk size, for every LOD and stitching mask
+    struct ChunkLists {
+        int quadsX = 0;
+        int quadsZ = 0;
+        IndexRange ranges[kMaxLod + 1][16];
+    };
+
+    struct Chunk {
+        int x0 = 0;
+        int z0 = 0;
+        int quadsX = 0;
+        int quadsZ = 0;
+        float minHeight = 0.0f;
+        float maxHeight = 0.0f;
+        int lod = 0;
+        std::size_t lists = 0; // index into m_lists for the chunk's size
+    };
+
+    // Index into m_lists of the lists for a quadsX x quadsZ chunk, built on first use
+    std::size_t chunkLists(int quadsX, int quadsZ);
+    // Appends the triangles of a quadsX x quadsZ block drawn every step nodes, with fans on the masked edges
+    IndexRange appendChunkIndices(int quadsX, int quadsZ, int step, unsigned int edgeMask);
+    float distanceToChunk(const ngl::Vec3& eye, const Chunk& chunk) const;
+
+    std::vector<Chunk> m_chunks;
+    std::vector<std::uint32_t> m_indices;
+    // Full chunks first, then at most three sizes cut short by the border
+    std::vector<ChunkLists> m_lists;
+    unsigned int m_width = 0;
+    unsigned int m_depth = 0;
+    float m_spacing = 1.0f;
+    int m_chunksX = 0;
+    int m_chunksZ = 0;
+    float m_lodDistance = 128.0f;
+    std::size_t m_selectedTriangles = 0;
+};
+
+#endif //TERRAINLOD_H
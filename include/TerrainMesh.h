@@ -0,0 +1,41 @@
+/**
+ * CPU side terrain mesh building.
+ * Turns a HeightField into vertex data for the renderer. Kept free of GL so Plane, the
+ * benchmarks and any other tools share one implementation.
+ */
+
+#ifndef TERRAINMESH_H
+#define TERRAINMESH_H
+
+#include <cstdint>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "HeightField.h"
+
+// One vertex per grid node in row order (index z * width + x), shared by the neighbouring cells
+void buildGridVertices(const HeightField& heightField, std::vector<ngl::Vec3>& vertices);
+
+// GL_TRIANGLES indices into the grid vertices, two triangles per cell.
+// Only depends on the grid size, so callers keep it until width or depth change.
+// Leaves indices empty for grids smaller than 2x2.
+void buildGridIndices(unsigned int width, unsigned int depth, std::vector<std::uint32_t>& indices);
+
+// Height-only vertex stream: one float per grid node in row order, which is exactly the
+// HeightField's own storage, so it is uploaded straight from HeightField::data().
+// HeightGridVertex.glsl rebuilds x/z from gl_VertexID; gridVertexPosition() is the same
+// reconstruction on the CPU so the layout can be checked without a GPU.
+constexpr std::size_t kHeightStreamStride = sizeof(float);
+constexpr std::size_t kPositionStreamStride = sizeof(ngl::Vec3);
+
+ngl::Vec3 gridVertexPosition(std::uint32_t vertexId, unsigned int width, float spacing, float height);
+
+// Contiguous part of a row major vertex buffer covering every node of rect
+struct GridUploadRange {
+    std::size_t firstVertex = 0;
+    std::size_t vertexCount = 0;
+    std::size_t byteOffset = 0;
+    std::size_t byteSize = 0;
+};
+GridUploadRange gridUploadRange(const GridRect& rect, unsigned int width, std::size_t stride);
+
+#endif //TERRAINMESH_H
@@ -0,0 +1,73 @@
+/**
+ * Thermal weathering: material slides off slopes steeper than the talus angle.
+ *
+ * One iteration is a Jacobi sweep over the grid. Every node reads the old heights of its four
+ * neighbours and writes its new height to a second buffer, which is then swapped in. The amount
+ * moved between two nodes depends only on their old heights, so what one node loses its neighbour
+ * gains exactly and the total height is kept. Rows run in parallel bands, the result doesn't
+ * depend on the thread count, and the row loop is plain float math the compiler vectorises.
+ *
+ * Runs on its own as an ErosionModel, or as the clean up pass HydraulicErosion::erode runs after
+ * its droplets (setTalusIterations), which slumps the spikes and pits droplets leave behind.
+ */
+
+#ifndef THERMALEROSION_H
+#define THERMALEROSION_H
+
+#include <algorithm>
+#include <vector>
+#include "ErosionModel.h"
+
+class ThermalErosion : public ErosionModel {
+public:
+    // Runs up to `iterations` sweeps, stopping early once nothing moves
+    void erode(HeightField& heightField, int iterations) override;
+
+    // ErosionModel, erosionRate maps to the settling rate, deposition and evaporation don't apply
+    const char* getName() const override { return "thermal"; }
+    std::unique_ptr<ErosionModel> clone() const override;
+    void setParameters(const ErosionParameters& parameters) override;
+    ErosionParameters getParameters() const override;
+    int getStepSize() const override { return kIterationsPerStep; }
+    // Nothing carries over between calls, this only frees the scratch buffer
+    void reset() override;
+
+    const DirtyTileMap& getDirtyTiles() const override { return m_dirtyTiles; }
+    void clearDirtyTiles() override { m_dirtyTiles.clear(); }
+
+    // Steepest stable slope, as height difference per unit of horizontal distance (tan of the talus angle)
+    void setTalusSlope(float slope) { m_talusSlope = std::max(0.0f, slope); }
+    float getTalusSlope() const { return m_talusSlope; }
+    // Share of the excess height moved per sweep, 1 brings a lone spike straight down to the talus slope
+    void setSettlingRate(float rate) { m_settlingRate = std::clamp(rate, 0.0f, 1.0f); }
+    float getSettlingRate() const { return m_settlingRate; }
+
+    // Worker threads for the sweeps, 0 uses every hardware thread
+    void setThreadCount(unsigned int count) { m_threadCount = count; }
+    unsigned int getThreadCount() const { return m_threadCount; }
+
+private:
+    // Rows per parallelFor task
+    static constexpr unsigned int kRowsPerTask = 16;
+    // Sweeps per step(), also the worker's progress and cancel granularity
+    static constexpr int kIterationsPerStep = 4;
+
+    // One sweep of rows [firstRow, lastRow) from source into target. changedChunks gets a flag per
+    // dirty tile column whose nodes changed, returns whether any node did.
+    bool relaxRows(const HeightField& source, HeightField& target,
+                   unsigned int firstRow, unsigned int lastRow, char* changedChunks) const;
+
+    float m_talusSlope = 1.0f;
+    float m_settlingRate = 0.5f;
+    unsigned int m_threadCount = 0;
+
+    // Second buffer of the Jacobi sweep, swapped with the height field after each sweep
+    HeightField m_scratch;
+    // Per band and dirty tile column: changed during this erode() call
+    std::vector<char> m_changedChunks;
+    // Per band: changed during the current sweep
+    std::vector<char> m_bandChanged;
+    DirtyTileMap m_dirtyTiles;
+};
+
+#endif //THERMALEROSION_H
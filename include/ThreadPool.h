@@ -0,0 +1,54 @@
+/**
+ * Persistent worker threads behind parallelFor.
+ * The threads are started on first use and then sleep between jobs, so the per call cost of
+ * a parallel pass is a wake up rather than creating and joining threads. Jobs pull indices from
+ * a shared atomic counter and the calling thread works on its own job too, so a job always
+ * finishes even when every worker is busy, several threads can submit jobs at once and a job
+ * may start another one from inside its body.
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // Calls task(context, index) for one index of the job
+    using Task = void (*)(void* context, std::size_t index);
+
+    ThreadPool() = default;
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // The pool every parallelFor shares, created on first use
+    static ThreadPool& shared();
+
+    // Runs task for every index in [0, count) on the calling thread plus up to threadCount - 1
+    // workers and returns when all of them are done. Starts more workers if threadCount needs them.
+    void run(std::size_t count, unsigned int threadCount, Task task, void* context);
+
+    std::size_t getWorkerCount() const;
+
+private:
+    struct Job;
+
+    void workerLoop();
+    static void work(Job& job);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_jobDone;
+    // Jobs still taking on workers, oldest first
+    std::deque<Job*> m_jobs;
+    std::vector<std::thread> m_workers;
+    bool m_stopping = false;
+};
+
+#endif //THREADPOOL_H
@@ -0,0 +1,109 @@
+/**
+ * Height field larger than memory, stored as square tiles in memory mapped files.
+ *
+ * Each tile is one file of tileSize x tileSize float32 heights in row order (tiles on the right and
+ * bottom edges are padded to full size), next to a small text manifest with the grid size. Only the
+ * most recently used tiles stay mapped, up to the cache capacity; older ones are unmapped and the
+ * kernel writes their pages back to the file. Callers copy rectangles in and out as ordinary
+ * HeightFields, which is also how neighbouring tiles share their borders (see TiledTerrain.h).
+ * read() and write() are safe to call from several threads. The lock only covers the tile cache:
+ * a tile in use is pinned so it can't be unmapped under the copy, and the copies themselves, as
+ * well as mapping and unmapping tile files, run unlocked in parallel. Calls touching the same nodes
+ * at the same time, with at least one of them writing, still need ordering by the caller.
+ */
+
+#ifndef TILEDHEIGHTFIELD_H
+#define TILEDHEIGHTFIELD_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "HeightField.h"
+
+class MappedTileFile;
+
+class TiledHeightField {
+public:
+    static constexpr unsigned int kDefaultTileSize = 1024;
+    // 256 MB of mapped 1024^2 tiles
+    static constexpr std::size_t kDefaultCacheTiles = 64;
+
+    TiledHeightField();
+    ~TiledHeightField();
+    TiledHeightField(const TiledHeightField&) = delete;
+    TiledHeightField& operator=(const TiledHeightField&) = delete;
+
+    // Starts a width x depth field in directory, which is created if needed. Existing tile files are
+    // replaced, heights start at 0 and tile files are only created once a tile is first touched.
+    bool create(const std::string& directory, unsigned int width, unsigned int depth, float spacing,
+                unsigned int tileSize = kDefaultTileSize);
+    // Opens a field made by create() in an earlier run
+    bool open(const std::string& directory);
+    // Unmaps every tile, the files keep the heights
+    void close();
+
+    unsigned int getWidth() const { return m_width; }
+    unsigned int getDepth() const { return m_depth; }
+    float getSpacing() const { return m_spacing; }
+    unsigned int getTileSize() const { return m_tileSize; }
+    unsigned int getTilesX() const { return m_tilesX; }
+    unsigned int getTilesZ() const { return m_tilesZ; }
+    bool empty() const { return m_width == 0 || m_depth == 0; }
+
+    // Nodes of tile (tileX, tileZ), clipped to the field
+    GridRect tileRect(unsigned int tileX, unsigned int tileZ) const;
+
+    // Most tiles mapped at once, at least 1. Lowering it unmaps the least recently used tiles.
+    void setCacheCapacity(std::size_t tiles);
+    std::size_t getCacheCapacity() const { return m_cacheCapacity; }
+    std::size_t getMappedTiles() const;
+
+    // Copies the nodes of rect into heightField, resized to the rect. rect must lie inside the field.
+    bool read(const GridRect& rect, HeightField& heightField);
+    // Copies heightField, the size of rect, back onto the nodes of rect
+    bool write(const GridRect& rect, const HeightField& heightField);
+    // Writes the mapped tiles back to their files without unmapping them
+    bool flush();
+
+private:
+    // A mapped tile stays pinned, and mapped, while anyone holds a reference to it
+    using TileReference = std::shared_ptr<MappedTileFile>;
+
+    struct CachedTile {
+        TileReference file;
+        std::list<std::size_t>::iterator lruPosition;
+    };
+
+    bool writeManifest() const;
+    std::string tilePath(std::size_t tile) const;
+    // Maps the tile if needed, marks it most recently used and returns it pinned. Takes m_mutex
+    // for the cache lookup only, the file is mapped without it.
+    TileReference acquireTile(std::size_t tile);
+    // Drops least recently used tiles from the cache until at most `tiles` remain, m_mutex must be held.
+    // They are moved to evicted, so the caller unmaps them after unlocking; pinned ones stay mapped
+    // until their last user lets go.
+    void evictDownTo(std::size_t tiles, std::vector<TileReference>& evicted);
+    // Copies the tiles under rect into readTarget, or writeSource onto them when it is set.
+    // Both hold the rect's nodes row by row.
+    bool copyRect(const GridRect& rect, float* readTarget, const float* writeSource);
+
+    std::string m_directory;
+    unsigned int m_width = 0;
+    unsigned int m_depth = 0;
+    float m_spacing = 1.0f;
+    unsigned int m_tileSize = kDefaultTileSize;
+    unsigned int m_tilesX = 0;
+    unsigned int m_tilesZ = 0;
+
+    std::size_t m_cacheCapacity = kDefaultCacheTiles;
+    std::unordered_map<std::size_t, CachedTile> m_mapped;
+    // Mapped tile indices, most recently used first
+    std::list<std::size_t> m_lru;
+    mutable std::mutex m_mutex;
+};
+
+#endif //TILEDHEIGHTFIELD_H
@@ -0,0 +1,38 @@
+/**
+ * Generation and erosion streamed over a TiledHeightField, one tile in memory at a time.
+ *
+ * Erosion runs tile by tile on a window of the tile plus a halo of its neighbours' nodes, read from
+ * the tiles around it. The halo gives droplets and water the terrain beyond the tile border,
+ * including whatever the neighbours eroded before. The window's height change is written back with
+ * weights that fade it out across the border while the neighbour's window fades in, adding up to 1,
+ * so every node gets one window's worth of erosion and the border shows no step. What leaves the
+ * window is lost, as at the edge of a single grid.
+ */
+
+#ifndef TILEDTERRAIN_H
+#define TILEDTERRAIN_H
+
+#include <cstddef>
+#include <functional>
+#include "ErosionModel.h"
+#include "TerrainGenerator.h"
+#include "TiledHeightField.h"
+
+// Called after each tile with the tiles done and the tile count
+using TileProgress = std::function<void(std::size_t tilesDone, std::size_t tileCount)>;
+
+// Nodes of neighbouring tiles around each erosion window
+constexpr unsigned int kDefaultTileHalo = 64;
+
+// Fills every tile with the generator's terrain for the whole field, the same heights
+// generateTerrain gives a single grid of that size
+bool generateTiled(TerrainGenerator& generator, TiledHeightField& field, int maxHeight,
+                   const TileProgress& progress = {});
+
+// Runs `iterations` of the model over the whole field, tile by tile in row order. Each window gets
+// model.regionIterations() for its share of the field and starts from a reset model; the
+// droplet model keeps counting droplets across windows so windows don't repeat one droplet pattern.
+bool erodeTiled(ErosionModel& model, TiledHeightField& field, int iterations,
+                unsigned int halo = kDefaultTileHalo, const TileProgress& progress = {});
+
+#endif //TILEDTERRAIN_H
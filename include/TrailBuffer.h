@@ -0,0 +1,65 @@
+/**
+ * Fixed capacity ring buffer of droplet trail points (x, height, z, lifetime).
+ * Once full the oldest points are overwritten, so memory stays at the budget however many
+ * droplets are run. getTotalWritten() counts every point ever pushed and getGeneration()
+ * changes on clear(), which lets renderers upload only what is new since they last looked.
+ */
+
+#ifndef TRAILBUFFER_H
+#define TRAILBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <ngl/Vec4.h>
+
+class TrailBuffer {
+public:
+    // 1M points, 16 MB
+    static constexpr std::size_t kDefaultCapacity = 1 << 20;
+
+    // Contiguous run of points, a ring's contents are at most two of these
+    struct Span {
+        const ngl::Vec4* data = nullptr;
+        std::size_t size = 0;
+    };
+
+    explicit TrailBuffer(std::size_t capacity = kDefaultCapacity) : m_capacity(capacity) {}
+
+    // Changing the capacity drops every point
+    void setCapacity(std::size_t capacity);
+    std::size_t getCapacity() const { return m_capacity; }
+
+    void push(const ngl::Vec4& point) {
+        if (m_points.size() < m_capacity) {
+            m_points.push_back(point);
+        } else if (m_capacity != 0) {
+            m_points[m_head] = point;
+            m_head = m_head + 1 == m_capacity ? 0 : m_head + 1;
+        }
+        ++m_totalWritten;
+    }
+    // Appends other's points oldest first
+    void append(const TrailBuffer& other);
+    void clear();
+
+    std::size_t size() const { return m_points.size(); }
+    bool empty() const { return m_points.empty(); }
+    std::uint64_t getTotalWritten() const { return m_totalWritten; }
+    std::uint64_t getGeneration() const { return m_generation; }
+
+    // Points still held that were written after the first `written` points, oldest first.
+    // spansSince(0, ...) is the whole ring.
+    void spansSince(std::uint64_t written, Span& first, Span& second) const;
+    // Copies the points oldest first
+    void copyTo(std::vector<ngl::Vec4>& points) const;
+
+private:
+    std::vector<ngl::Vec4> m_points;
+    std::size_t m_capacity;
+    std::size_t m_head = 0; // oldest point (and next write) once the ring is full
+    std::uint64_t m_totalWritten = 0;
+    std::uint64_t m_generation = 0;
+};
+
+#endif //TRAILBUFFER_H
@@ -0,0 +1,43 @@
+/**
+ * Keeps a GPU copy of a TrailBuffer in step with the CPU ring without a GL context.
+ * The GPU buffer mirrors the ring slot for slot (point k of the ring lives in slot k % capacity),
+ * so each frame only the points written since the last update have to be copied, at most as two runs.
+ */
+
+#ifndef TRAILUPLOADTRACKER_H
+#define TRAILUPLOADTRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ngl/Vec4.h>
+#include "TrailBuffer.h"
+
+class TrailUploadTracker {
+public:
+    // count points from data go into the GPU buffer starting at slot firstSlot
+    struct Range {
+        const ngl::Vec4* data = nullptr;
+        std::size_t firstSlot = 0;
+        std::size_t count = 0;
+    };
+
+    struct Update {
+        bool reallocate = false;   // (re)create the GPU buffer with room for capacity points
+        std::size_t capacity = 0;
+        Range ranges[2];
+        std::size_t drawCount = 0; // valid points, always slots [0, drawCount)
+    };
+
+    // Works out what changed in trail since the last call and treats it as uploaded
+    Update update(const TrailBuffer& trail);
+    // The next update() reallocates and uploads everything, e.g. for a new GL buffer
+    void reset() { m_allocated = false; }
+
+private:
+    bool m_allocated = false;
+    std::size_t m_capacity = 0;
+    std::uint64_t m_generation = 0;
+    std::uint64_t m_uploaded = 0; // trail.getTotalWritten() at the last update
+};
+
+#endif //TRAILUPLOADTRACKER_H
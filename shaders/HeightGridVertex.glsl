@@ -0,0 +1,19 @@
+#version 330 core
+//HeightGridVertex.glsl
+// Height-only terrain stream: x/z are rebuilt from the vertex index, so only one float per vertex is uploaded.
+// Keep in step with gridVertexPosition() in TerrainMesh.h
+uniform mat4 MVP;
+uniform int gridWidth;
+uniform float gridSpacing;
+
+layout (location=0) in float inHeight;
+out float outHeight; // Pass the height to the fragment shader
+void main()
+{
+    // gl_VertexID is the index buffer value, i.e. z * gridWidth + x
+    float x = float(gl_VertexID % gridWidth) * gridSpacing;
+    float z = float(gl_VertexID / gridWidth) * gridSpacing;
+    gl_Position = MVP * vec4(x, inHeight, z, 1.0);
+
+    outHeight = inHeight;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+//TrailVertex.glsl
+// Droplet trail points: only x, height, z and lifetime are uploaded, the colour is built here from the lifetime
+uniform mat4 MVP;
+uniform float pointSize;
+uniform float trailAlpha;
+
+layout (location=0) in vec4 inPoint;
+out vec4 vertColour;
+void main()
+{
+    gl_Position = MVP * vec4(inPoint.xyz, 1.0);
+    gl_PointSize = pointSize;
+    // Longer lived droplets are redder
+    vertColour = vec4(clamp(inPoint.w / 100.0, 0.0, 1.0), 0.0, 0.0, trailAlpha);
+}
@@ -0,0 +1,94 @@
+#include "DirtyTileMap.h"
+#include <algorithm>
+
+void DirtyTileMap::resize(unsigned int width, unsigned int depth, int tileSize)
+{
+    tileSize = std::max(1, tileSize);
+    if (width == m_width && depth == m_depth && tileSize == m_tileSize && !m_tiles.empty()) {
+        return;
+    }
+    m_width = width;
+    m_depth = depth;
+    m_tileSize = tileSize;
+    m_tilesX = (static_cast<int>(width) + tileSize - 1) / tileSize;
+    m_tilesZ = (static_cast<int>(depth) + tileSize - 1) / tileSize;
+    m_tiles.assign(static_cast<std::size_t>(m_tilesX) * m_tilesZ, 0);
+    m_dirtyCount = 0;
+    m_bounds = GridRect();
+}
+
+void DirtyTileMap::clear()
+{
+    if (m_dirtyCount == 0) {
+        return;
+    }
+    std::fill(m_tiles.begin(), m_tiles.end(), 0);
+    m_dirtyCount = 0;
+    m_bounds = GridRect();
+}
+
+void DirtyTileMap::mark(const GridRect& rect)
+{
+    const int minX = std::max(0, rect.minX);
+    const int minZ = std::max(0, rect.minZ);
+    const int maxX = std::min(static_cast<int>(m_width), rect.maxX);
+    const int maxZ = std::min(static_cast<int>(m_depth), rect.maxZ);
+    if (minX >= maxX || minZ >= maxZ) {
+        return;
+    }
+
+    const int tileMinX = minX / m_tileSize;
+    const int tileMinZ = minZ / m_tileSize;
+    const int tileMaxX = (maxX - 1) / m_tileSize;
+    const int tileMaxZ = (maxZ - 1) / m_tileSize;
+    for (int tz = tileMinZ; tz <= tileMaxZ; ++tz)
+    {
+        unsigned char* tiles = m_tiles.data() + static_cast<std::size_t>(tz) * m_tilesX;
+        for (int tx = tileMinX; tx <= tileMaxX; ++tx)
+        {
+            m_dirtyCount += tiles[tx] == 0 ? 1 : 0;
+            tiles[tx] = 1;
+        }
+    }
+
+    // Bounds are kept on tile edges so they always cover whole dirty tiles
+    m_bounds.unite(GridRect{tileMinX * m_tileSize, tileMinZ * m_tileSize,
+                            std::min(static_cast<int>(m_width), (tileMaxX + 1) * m_tileSize),
+                            std::min(static_cast<int>(m_depth), (tileMaxZ + 1) * m_tileSize)});
+}
+
+void DirtyTileMap::markAll()
+{
+    mark(GridRect{0, 0, static_cast<int>(m_width), static_cast<int>(m_depth)});
+}
+
+void DirtyTileMap::unite(const DirtyTileMap& other)
+{
+    // Nothing to add, also from a map that was never sized, e.g. a pass that returned early
+    if (!other.any()) {
+        return;
+    }
+    if (m_tiles.empty()) {
+        *this = other;
+        return;
+    }
+    if (other.m_width != m_width || other.m_depth != m_depth || other.m_tileSize != m_tileSize) {
+        // Different grids can't be merged tile by tile, everything has to be redone
+        markAll();
+        return;
+    }
+
+    for (std::size_t i = 0; i < m_tiles.size(); ++i)
+    {
+        m_dirtyCount += (m_tiles[i] == 0 && other.m_tiles[i] != 0) ? 1 : 0;
+        m_tiles[i] |= other.m_tiles[i];
+    }
+    m_bounds.unite(other.m_bounds);
+}
+
+GridRect DirtyTileMap::tileRect(int tileX, int tileZ) const
+{
+    return GridRect{tileX * m_tileSize, tileZ * m_tileSize,
+                    std::min(static_cast<int>(m_width), (tileX + 1) * m_tileSize),
+                    std::min(static_cast<int>(m_depth), (tileZ + 1) * m_tileSize)};
+}
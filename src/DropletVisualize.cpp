@@ -22,54 +22,42 @@ m_maxParticles{_num}, m_maxAlive{_maxAlive}, m_numPerFrame{_numPerFrame},m_pos{_
       );
     m_vao->bind();
     m_vao->setData(ngl::MultiBufferVAO::VertexData(0,0)); // index 0 points
-    m_vao->setData(ngl::MultiBufferVAO::VertexData(0,0)); // index 1 colours
+    m_vao->setVertexAttributePointer(0, 4, GL_FLOAT, 0, 0);
     m_vao->unbind();
 }
 
 
-void DropletVisualize::drawTrailPoints(const std::vector<ngl::Vec4> &_points) const
+void DropletVisualize::drawTrailPoints(const TrailBuffer &_points)
 {
-    if (!_points.empty() && m_showTrailPoints == false)
-        return;
-    float alpha = 0.1;
-    // Position data (as is)
-    std::vector<ngl::Vec4> pointData = _points;
+    // Keep the GPU copy up to date even while hidden, so showing the trails again is cheap
+    const TrailUploadTracker::Update upload = m_trailUpload.update(_points);
 
-    // Color data — use w (lifetime) as red channel
-    std::vector<ngl::Vec4> colourData;
-    colourData.reserve(_points.size());
-
-    for (const auto &p : _points)
+    glBindBuffer(GL_ARRAY_BUFFER, m_vao->getBufferID(0));
+    if (upload.reallocate)
     {
-        float red = p.m_w / 100.0f; // Using lifetime as colour
-        red = std::clamp(red, 0.0f, 100.0f);
-        colourData.emplace_back(red, 0.0f, 0.0f, alpha);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(upload.capacity * sizeof(ngl::Vec4)),
+                     nullptr, GL_DYNAMIC_DRAW);
     }
+    for (const auto &range : upload.ranges)
+    {
+        if (range.count != 0)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(range.firstSlot * sizeof(ngl::Vec4)),
+                            static_cast<GLsizeiptr>(range.count * sizeof(ngl::Vec4)), range.data);
+        }
+    }
+    m_trailDrawCount = upload.drawCount;
 
-    m_vao->bind();
-
-    // Upload positions
-    m_vao->setData(0, ngl::MultiBufferVAO::VertexData(pointData.size() * sizeof(ngl::Vec4),
-                                                      pointData[0].m_x));
-    m_vao->setVertexAttributePointer(0, 4, GL_FLOAT, 0, 0);
-
-    // Upload colors
-    m_vao->setData(1, ngl::MultiBufferVAO::VertexData(colourData.size() * sizeof(ngl::Vec4),
-                                                      colourData[0].m_x));
-    m_vao->setVertexAttributePointer(1, 4, GL_FLOAT, 0, 0);
+    if (m_trailDrawCount == 0 || m_showTrailPoints == false)
+        return;
 
-    m_vao->setNumIndices(_points.size());
+    m_vao->bind();
+    m_vao->setNumIndices(m_trailDrawCount);
 
     glEnable(GL_PROGRAM_POINT_SIZE);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glPointSize(3.0f);
     m_vao->draw();
     glDisable(GL_PROGRAM_POINT_SIZE);
     m_vao->unbind();
 }
-
-
-
-
-
@@ -0,0 +1,96 @@
+#include "ErosionWorker.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include "PyramidErosion.h"
+
+ErosionWorker::ErosionWorker(const HeightField& heightField, const ErosionModel& erosion, int totalIterations)
+    : m_heightField(heightField), m_erosion(erosion.clone()),
+      m_totalIterations(std::max(0, totalIterations))
+{
+    m_droplets = dynamic_cast<HydraulicErosion*>(&PyramidErosion::fullResolutionModel(*m_erosion));
+    m_erosion->clearDirtyTiles();
+    m_snapshot.heightField = m_heightField;
+    if (m_droplets) {
+        // Snapshots only carry new trail points, the GUI keeps the ones it already has
+        m_droplets->clearDropletTrailPoints();
+        m_snapshot.trailPoints.setCapacity(m_droplets->getTrailCapacity());
+    } else {
+        m_snapshot.trailPoints.setCapacity(0);
+    }
+}
+
+void ErosionWorker::run()
+{
+    auto lastPublish = std::chrono::steady_clock::now();
+    int iterationsDone = 0;
+
+    // One model step per erode() call, which is also the cancellation granularity
+    const int stepSize = std::max(1, m_erosion->getStepSize());
+    while (iterationsDone < m_totalIterations && !isCancelled())
+    {
+        const int chunk = std::min(stepSize, m_totalIterations - iterationsDone);
+        m_erosion->erode(m_heightField, chunk);
+        iterationsDone += chunk;
+        emit progress(iterationsDone, m_totalIterations);
+
+        // Copying the grid every chunk would cost more than the erosion on large maps,
+        // so publish at most once per frame
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastPublish >= std::chrono::milliseconds(kSnapshotIntervalMs)) {
+            publishSnapshot(iterationsDone);
+            lastPublish = now;
+        }
+    }
+
+    // The GUI only takes the heights back, so material the model still carries goes onto the terrain
+    m_erosion->settle(m_heightField);
+    // The final state is always published, also after a cancel, so finished work is kept
+    publishSnapshot(iterationsDone);
+    emit finished(isCancelled());
+}
+
+void ErosionWorker::publishSnapshot(int iterationsDone)
+{
+    // The grid copy goes into the worker's back buffer outside the lock, so takeSnapshot() never
+    // waits for it. Same sized copy after the first one, the buffers only rotate.
+    m_backHeightField = m_heightField;
+    {
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        // The GUI's old buffer, or an unclaimed snapshot, becomes the next back buffer
+        std::swap(m_snapshot.heightField, m_backHeightField);
+        m_snapshot.dirtyTiles.unite(m_erosion->getDirtyTiles());
+        if (m_droplets) {
+            m_snapshot.trailPoints.append(m_droplets->getDropletTrailPoints());
+            m_snapshot.dropletCounter = m_droplets->getDropletCounter();
+        }
+        m_snapshot.iterationsDone = iterationsDone;
+        m_snapshotFresh = true;
+    }
+    if (m_droplets) {
+        m_droplets->clearDropletTrailPoints();
+    }
+    m_erosion->clearDirtyTiles();
+    emit snapshotReady();
+}
+
+bool ErosionWorker::takeSnapshot(ErosionSnapshot& snapshot)
+{
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+    if (!m_snapshotFresh) {
+        return false;
+    }
+    // Swap rather than copy, the caller's old buffers become the worker's next back buffer
+    std::swap(snapshot.heightField, m_snapshot.heightField);
+    std::swap(snapshot.trailPoints, m_snapshot.trailPoints);
+    if (m_snapshot.trailPoints.getCapacity() != snapshot.trailPoints.getCapacity()) {
+        m_snapshot.trailPoints.setCapacity(snapshot.trailPoints.getCapacity());
+    }
+    m_snapshot.trailPoints.clear();
+    std::swap(snapshot.dirtyTiles, m_snapshot.dirtyTiles);
+    m_snapshot.dirtyTiles.clear();
+    snapshot.dropletCounter = m_snapshot.dropletCounter;
+    snapshot.iterationsDone = m_snapshot.iterationsDone;
+    m_snapshotFresh = false;
+    return true;
+}
@@ -0,0 +1,21 @@
+#include "HeightField.h"
+
+HeightField::HeightField(unsigned int width, unsigned int depth, float spacing, float initialHeight)
+{
+    resize(width, depth, spacing, initialHeight);
+}
+
+void HeightField::resize(unsigned int width, unsigned int depth, float spacing, float initialHeight)
+{
+    m_width = width;
+    m_depth = depth;
+    m_spacing = spacing;
+    m_heights.assign(static_cast<std::size_t>(width) * depth, initialHeight);
+}
+
+void HeightField::clear()
+{
+    m_heights.clear();
+    m_width = 0;
+    m_depth = 0;
+}
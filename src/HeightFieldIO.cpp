@@ -0,0 +1,172 @@
+#include "HeightFieldIO.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+bool hasExtension(const std::string& path, const std::string& extension)
+{
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// Writes the rows of heights as 16 bit PGM samples, most significant byte first
+void writePGMRows(std::ofstream& file, const HeightField& heights, float minHeight, float scale,
+                  std::vector<unsigned char>& row)
+{
+    row.resize(heights.getWidth() * 2);
+    for (unsigned int z = 0; z < heights.getDepth(); ++z)
+    {
+        const float* values = heights.row(z);
+        for (unsigned int x = 0; x < heights.getWidth(); ++x)
+        {
+            float value = std::clamp((values[x] - minHeight) * scale, 0.0f, 65535.0f);
+            auto sample = static_cast<std::uint16_t>(value + 0.5f);
+            row[x * 2] = static_cast<unsigned char>(sample >> 8);
+            row[x * 2 + 1] = static_cast<unsigned char>(sample & 0xFF);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+}
+
+bool isLittleEndianHost()
+{
+    const std::uint32_t probe = 1;
+    unsigned char first = 0;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Writes heights as little endian float32, swapping a row at a time on big endian hosts
+void writeLittleEndianFloats(std::ofstream& file, const HeightField& heights)
+{
+    if (isLittleEndianHost()) {
+        file.write(reinterpret_cast<const char*>(heights.data()),
+                   static_cast<std::streamsize>(heights.size() * sizeof(float)));
+        return;
+    }
+    std::vector<unsigned char> row(heights.getWidth() * sizeof(float));
+    for (unsigned int z = 0; z < heights.getDepth(); ++z)
+    {
+        std::memcpy(row.data(), heights.row(z), row.size());
+        for (std::size_t i = 0; i < row.size(); i += sizeof(float))
+        {
+            std::swap(row[i], row[i + 3]);
+            std::swap(row[i + 1], row[i + 2]);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+}
+
+// Calls visit with each band of one tile row across the whole field, top to bottom
+template <typename Visit>
+bool forEachTileBand(TiledHeightField& field, Visit visit)
+{
+    HeightField band;
+    for (unsigned int tileZ = 0; tileZ < field.getTilesZ(); ++tileZ) {
+        const GridRect tile = field.tileRect(0, tileZ);
+        if (!field.read({0, tile.minZ, static_cast<int>(field.getWidth()), tile.maxZ}, band)) {
+            return false;
+        }
+        visit(band);
+    }
+    return true;
+}
+}
+
+bool writeHeightFieldPGM(const HeightField& heightField, const std::string& path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "writeHeightFieldPGM() - Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+    if (!heightField.empty()) {
+        auto range = std::minmax_element(heightField.data(), heightField.data() + heightField.size());
+        minHeight = *range.first;
+        maxHeight = *range.second;
+    }
+    const float scale = maxHeight > minHeight ? 65535.0f / (maxHeight - minHeight) : 0.0f;
+
+    file << "P5\n" << heightField.getWidth() << " " << heightField.getDepth() << "\n65535\n";
+
+    std::vector<unsigned char> row;
+    writePGMRows(file, heightField, minHeight, scale, row);
+    return static_cast<bool>(file);
+}
+
+bool writeHeightFieldRaw(const HeightField& heightField, const std::string& path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "writeHeightFieldRaw() - Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+    writeLittleEndianFloats(file, heightField);
+    return static_cast<bool>(file);
+}
+
+bool writeHeightField(const HeightField& heightField, const std::string& path)
+{
+    if (hasExtension(path, ".pgm")) {
+        return writeHeightFieldPGM(heightField, path);
+    }
+    return writeHeightFieldRaw(heightField, path);
+}
+
+bool writeHeightFieldPGM(TiledHeightField& field, const std::string& path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "writeHeightFieldPGM() - Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+    bool first = true;
+    const bool ranged = forEachTileBand(field, [&](const HeightField& band) {
+        if (band.empty()) {
+            return;
+        }
+        auto range = std::minmax_element(band.data(), band.data() + band.size());
+        minHeight = first ? *range.first : std::min(minHeight, *range.first);
+        maxHeight = first ? *range.second : std::max(maxHeight, *range.second);
+        first = false;
+    });
+    if (!ranged) {
+        return false;
+    }
+    const float scale = maxHeight > minHeight ? 65535.0f / (maxHeight - minHeight) : 0.0f;
+
+    file << "P5\n" << field.getWidth() << " " << field.getDepth() << "\n65535\n";
+    std::vector<unsigned char> row;
+    return forEachTileBand(field, [&](const HeightField& band) { writePGMRows(file, band, minHeight, scale, row); }) &&
+           static_cast<bool>(file);
+}
+
+bool writeHeightFieldRaw(TiledHeightField& field, const std::string& path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "writeHeightFieldRaw() - Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+    return forEachTileBand(field, [&](const HeightField& band) { writeLittleEndianFloats(file, band); }) &&
+           static_cast<bool>(file);
+}
+
+bool writeHeightField(TiledHeightField& field, const std::string& path)
+{
+    if (hasExtension(path, ".pgm")) {
+        return writeHeightFieldPGM(field, path);
+    }
+    return writeHeightFieldRaw(field, path);
+}
@@ -1,189 +1,656 @@
 #include "HydraulicErosion.h"
-#include <ngl/Random.h>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include "ParallelFor.h"
 
 HydraulicErosion::HydraulicErosion() {
     // Initialize any necessary state
 }
 
-void HydraulicErosion::erode(std::vector<ngl::Vec3>& heightGrid,
-                            unsigned int width,
-                            unsigned int depth,
-                            float spacing,
+std::unique_ptr<ErosionModel> HydraulicErosion::clone() const
+{
+    return std::make_unique<HydraulicErosion>(*this);
+}
+
+void HydraulicErosion::setParameters(const ErosionParameters& parameters)
+{
+    m_erosionRate = parameters.erosionRate;
+    m_depositionRate = parameters.depositionRate;
+    m_evaporationRate = parameters.evaporationRate;
+    m_threadCount = parameters.threads;
+}
+
+ErosionParameters HydraulicErosion::getParameters() const
+{
+    ErosionParameters parameters;
+    parameters.erosionRate = m_erosionRate;
+    parameters.depositionRate = m_depositionRate;
+    parameters.evaporationRate = m_evaporationRate;
+    parameters.threads = m_threadCount;
+    return parameters;
+}
+
+void HydraulicErosion::reset()
+{
+    m_dropletTrailPoints.clear();
+    m_dropletCounter = 0;
+    m_talusBacklog = 0;
+}
+
+void HydraulicErosion::erode(HeightField& heightField,
                             int numDroplets,
                             int dropletMaxLifetime)
+{
+    simulateDroplets(heightField, numDroplets, dropletMaxLifetime);
+    if (m_talusIterations > 0 && numDroplets > 0 && !heightField.empty()) {
+        m_talusBacklog += static_cast<std::int64_t>(numDroplets) * m_talusIterations;
+        const int sweeps = static_cast<int>(m_talusBacklog / kTalusDroplets);
+        m_talusBacklog %= kTalusDroplets;
+        if (sweeps > 0) {
+            m_talusPass.setThreadCount(m_threadCount);
+            m_talusPass.clearDirtyTiles();
+            m_talusPass.erode(heightField, sweeps);
+            m_dirtyTiles.unite(m_talusPass.getDirtyTiles());
+        }
+    }
+}
+
+void HydraulicErosion::simulateDroplets(HeightField& heightField,
+                                        int numDroplets,
+                                        int dropletMaxLifetime)
 {
     // Implementation of the erosion algorithm
     // This would be moved from Plane::applyHydraulicErosion
 
-    if (heightGrid.empty()) { return; }
+    if (heightField.empty()) { return; }
+
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    const float spacing = heightField.getSpacing();
 
-    // Initialize brush indices for erosion radius
+    // Build the brush stencil for this grid and radius (cached across calls while neither changes)
     computeAreaOfInfluence(width, depth, m_erosionRadius);
    // m_dropletTrailPoints.clear();
+    m_dirtyTiles.resize(width, depth);
+    m_dirtyRects.clear();
+
+    if (m_tileSize > 0)
+    {
+        erodeTiled(heightField, numDroplets, dropletMaxLifetime);
+        return;
+    }
+
+    const DropletBounds wholeMap{0, 0, static_cast<int>(width), static_cast<int>(depth)};
+
+    if (m_batchedSimulation)
+    {
+        // Packets of consecutive droplets advance in lockstep
+        DropletStart packet[kDropletLanes];
+        for (int first = 0; first < numDroplets; first += kDropletLanes)
+        {
+            int count = std::min(kDropletLanes, numDroplets - first);
+            for (int l = 0; l < count; ++l)
+            {
+                int randGridX = 0;
+                int randGridZ = 0;
+                dropletStartCell(m_dropletCounter + first + l, width, depth, randGridX, randGridZ);
+                packet[l] = {ngl::Vec2(static_cast<float>(randGridX) * spacing, static_cast<float>(randGridZ) * spacing),
+                             recordsTrail(m_dropletCounter + first + l)};
+            }
+            simulateDropletPacket(heightField, packet, count, dropletMaxLifetime, wholeMap, m_dropletTrailPoints, m_dirtyRects);
+        }
+        m_dropletCounter += numDroplets;
+        markDirtyRects(m_dirtyRects);
+        return;
+    }
 
         // For each droplet simulation
         for (int i = 0; i < numDroplets; ++i)
         {
             // Initialize Droplet to random pos
-            int randGridX = ngl::Random::randomPositiveNumber(width - 1);
-            int randGridZ = ngl::Random::randomPositiveNumber(depth - 1);
+            int randGridX = 0;
+            int randGridZ = 0;
+            dropletStartCell(m_dropletCounter + i, width, depth, randGridX, randGridZ);
 
             float startX = static_cast<float>(randGridX) * spacing;
             float startZ = static_cast<float>(randGridZ) * spacing;
-            Droplet droplet(ngl::Vec2(startX, startZ), m_initialSpeed, m_initialWaterAmount, dropletMaxLifetime);
+            simulateDroplet(heightField, ngl::Vec2(startX, startZ), dropletMaxLifetime, wholeMap,
+                            recordsTrail(m_dropletCounter + i) ? &m_dropletTrailPoints : nullptr, m_dirtyRects);
+        }
+        m_dropletCounter += numDroplets;
+        markDirtyRects(m_dirtyRects);
+}
 
-            // Simulate droplet movement and erosion
-            for (int step = 0; step < dropletMaxLifetime; ++step)
-            {
-                // Calculate height and gradient
-                HeightAndGradientData hgDataOld = getHeightAndGradient(heightGrid, width, depth, spacing, droplet.pos.m_x, droplet.pos.m_y);
-                // "Before" height
-                float originalTerrainHeight = hgDataOld.height;
-
-                // Update droplet direction based on the gradient
-                // Direction is influenced by inertia and terrain gradient
-                droplet.dir.m_x = (droplet.dir.m_x * m_inertiaFactor - hgDataOld.rawGradientAscent.m_x * (1 - m_inertiaFactor));
-                droplet.dir.m_y = (droplet.dir.m_y * m_inertiaFactor - hgDataOld.rawGradientAscent.m_y * (1 - m_inertiaFactor));
-
-                // Normalize direction vector
-                float length = std::sqrt((droplet.dir.m_x * droplet.dir.m_x) + (droplet.dir.m_y * droplet.dir.m_y));
-                if (length != 0) {
-                    droplet.dir.m_x /= length;
-                    droplet.dir.m_y /= length;
-                }
+void HydraulicErosion::markDirtyRects(const std::vector<GridRect>& rects)
+{
+    for (const GridRect& rect : rects) {
+        m_dirtyTiles.mark(rect);
+    }
+}
 
-                // Move droplet pos
-                droplet.pos.m_x += droplet.dir.m_x;
-                droplet.pos.m_y += droplet.dir.m_y;
+void HydraulicErosion::erodeTiled(HeightField& heightField,
+                                  int numDroplets,
+                                  int dropletMaxLifetime)
+{
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    const float spacing = heightField.getSpacing();
+
+    // Every cell a droplet touches lies within (radius + 1) cells of its own cell, and a droplet may
+    // wander `halo` cells outside its tile. Tiles of the same checkerboard colour are a full tile apart,
+    // so 2 * (halo + reach) <= tileSize keeps their footprints disjoint.
+    const int reach = m_erosionRadius + 1;
+    const int tileSize = std::max(m_tileSize, 2 * reach + 2);
+    const int halo = tileSize / 2 - reach;
+
+    const int tilesX = (static_cast<int>(width) + tileSize - 1) / tileSize;
+    const int tilesZ = (static_cast<int>(depth) + tileSize - 1) / tileSize;
+
+    // Bucket the droplets by the tile they start in, each tile keeps droplet index order
+    // so the result is identical for any thread count
+    std::vector<std::vector<DropletStart>> tileDroplets(tilesX * tilesZ);
+    for (int i = 0; i < numDroplets; ++i)
+    {
+        int randGridX = 0;
+        int randGridZ = 0;
+        dropletStartCell(m_dropletCounter + i, width, depth, randGridX, randGridZ);
+        int tile = (randGridZ / tileSize) * tilesX + (randGridX / tileSize);
+        tileDroplets[tile].push_back({ngl::Vec2(static_cast<float>(randGridX) * spacing,
+                                                static_cast<float>(randGridZ) * spacing),
+                                      recordsTrail(m_dropletCounter + i)});
+    }
+    m_dropletCounter += numDroplets;
 
-                // Add to trailpoint vector for visualisation
-                m_dropletTrailPoints.push_back(ngl::Vec4(droplet.pos.m_x, originalTerrainHeight, droplet.pos.m_y, static_cast<float>(droplet.lifetime)));
+    // Each tile records into its own ring with a share of the budget, merged afterwards
+    std::size_t activeTiles = 0;
+    for (const auto& starts : tileDroplets) {
+        activeTiles += starts.empty() ? 0 : 1;
+    }
+    const std::size_t tileTrailCapacity = isTrailRecording()
+        ? m_dropletTrailPoints.getCapacity() / std::max<std::size_t>(1, activeTiles) + 1 : 0;
+    std::vector<TrailBuffer> tileTrails(tileDroplets.size(), TrailBuffer(tileTrailCapacity));
+    std::vector<std::vector<GridRect>> tileDirty(tileDroplets.size());
+
+    // Four checkerboard phases, tiles inside a phase never share cells so they run concurrently
+    for (int phase = 0; phase < 4; ++phase)
+    {
+        std::vector<int> phaseTiles;
+        for (int tz = phase / 2; tz < tilesZ; tz += 2) {
+            for (int tx = phase % 2; tx < tilesX; tx += 2) {
+                if (!tileDroplets[tz * tilesX + tx].empty()) {
+                    phaseTiles.push_back(tz * tilesX + tx);
+                }
+            }
+        }
 
-                // Check termination conditions
-                droplet.lifetime--;
-                if (droplet.lifetime <= 0 || droplet.water <= 0.1f ) {
-                    break; // End this droplet's simulation
+        parallelFor(phaseTiles.size(), m_threadCount, [&](std::size_t i) {
+            const int tile = phaseTiles[i];
+            const int tx = tile % tilesX;
+            const int tz = tile / tilesX;
+            const DropletBounds bounds{
+                std::max(0, tx * tileSize - halo),
+                std::max(0, tz * tileSize - halo),
+                std::min(static_cast<int>(width), (tx + 1) * tileSize + halo),
+                std::min(static_cast<int>(depth), (tz + 1) * tileSize + halo)};
+
+            const std::vector<DropletStart>& starts = tileDroplets[tile];
+            if (m_batchedSimulation) {
+                for (size_t first = 0; first < starts.size(); first += kDropletLanes) {
+                    int count = static_cast<int>(std::min<size_t>(kDropletLanes, starts.size() - first));
+                    simulateDropletPacket(heightField, starts.data() + first, count, dropletMaxLifetime, bounds,
+                                          tileTrails[tile], tileDirty[tile]);
+                }
+            } else {
+                for (const DropletStart& start : starts) {
+                    simulateDroplet(heightField, start.pos, dropletMaxLifetime, bounds,
+                                    start.recordTrail ? &tileTrails[tile] : nullptr, tileDirty[tile]);
                 }
-                // If droplet moves off map, also break
-                if (droplet.pos.m_x < 0.0f || droplet.pos.m_x >= width * spacing ||
-                    droplet.pos.m_y < 0.0f || droplet.pos.m_y >= depth * spacing) {
-                    break;
-                    }
+            }
+        });
+    }
 
+    // Merge trails in tile order so the visualisation doesn't depend on thread scheduling
+    for (const TrailBuffer& trail : tileTrails) {
+        m_dropletTrailPoints.append(trail);
+    }
+    for (const std::vector<GridRect>& rects : tileDirty) {
+        markDirtyRects(rects);
+    }
+}
 
-                float newHeight = getHeightAndGradient(heightGrid, width, depth, spacing, droplet.pos.m_x, droplet.pos.m_y).height;
-                float deltaHeight = newHeight - originalTerrainHeight;
+void HydraulicErosion::simulateDroplet(HeightField& heightField,
+                                       ngl::Vec2 startPos,
+                                       int dropletMaxLifetime,
+                                       const DropletBounds& bounds,
+                                       TrailBuffer* trailPoints,
+                                       std::vector<GridRect>& dirtyRects)
+{
+    const float spacing = heightField.getSpacing();
+
+    Droplet droplet(startPos, m_initialSpeed, m_initialWaterAmount, dropletMaxLifetime);
+
+    // Range of positions the droplet wrote at, turned into a dirty rectangle at the end
+    float writeMinX = std::numeric_limits<float>::max();
+    float writeMinZ = std::numeric_limits<float>::max();
+    float writeMaxX = std::numeric_limits<float>::lowest();
+    float writeMaxZ = std::numeric_limits<float>::lowest();
+
+    // Simulate droplet movement and erosion
+    for (int step = 0; step < dropletMaxLifetime; ++step)
+    {
+        // Calculate height and gradient
+        HeightAndGradientData hgDataOld = getHeightAndGradient(heightField, droplet.pos.m_x, droplet.pos.m_y);
+        // "Before" height
+        float originalTerrainHeight = hgDataOld.height;
+
+        // Update droplet direction based on the gradient
+        // Direction is influenced by inertia and terrain gradient
+        droplet.dir.m_x = (droplet.dir.m_x * m_inertiaFactor - hgDataOld.rawGradientAscent.m_x * (1 - m_inertiaFactor));
+        droplet.dir.m_y = (droplet.dir.m_y * m_inertiaFactor - hgDataOld.rawGradientAscent.m_y * (1 - m_inertiaFactor));
+
+        // Normalize direction vector
+        float length = std::sqrt((droplet.dir.m_x * droplet.dir.m_x) + (droplet.dir.m_y * droplet.dir.m_y));
+        if (length != 0) {
+            droplet.dir.m_x /= length;
+            droplet.dir.m_y /= length;
+        }
 
-                // Calculate sediment capacity based on slope, speed and water volume
-                float sedimentCapacity = std::max(-deltaHeight * droplet.speed * droplet.water * m_sedimentCapacityFactor, m_minSedimentCapacity);
+        // Move droplet pos
+        droplet.pos.m_x += droplet.dir.m_x;
+        droplet.pos.m_y += droplet.dir.m_y;
 
-                // If carrying more sediment than capacity, deposit sediment
-                if (droplet.sediment > sedimentCapacity || deltaHeight > 0)
-                {
-                    // Calculate deposit amount based on height difference or sediment excess
-                    float calculated_deposit_amount = 0.0f;
-                    if (deltaHeight > 0) {
-                        // Original:
-                        // calculated_deposit_amount = std::min(deltaHeight, droplet.sediment);
-                        // Potentially less aggressive:
-                        calculated_deposit_amount = std::min(deltaHeight, droplet.sediment) * m_depositionRate; // Or a new, smaller rate
-                    } else {
-                        calculated_deposit_amount = (droplet.sediment - sedimentCapacity) * m_depositionRate;
-                    }
+        // Add to trailpoint buffer for visualisation
+#if TERRAIN_RECORD_TRAILS
+        if (trailPoints) {
+            trailPoints->push(ngl::Vec4(droplet.pos.m_x, originalTerrainHeight, droplet.pos.m_y, static_cast<float>(droplet.lifetime)));
+        }
+#endif
 
-                    float amountToDeposit = std::max(0.0f, calculated_deposit_amount);
-                    amountToDeposit = std::min(amountToDeposit, droplet.sediment);
+        // Check termination conditions
+        droplet.lifetime--;
+        if (droplet.lifetime <= 0 || droplet.water <= 0.1f ) {
+            break; // End this droplet's simulation
+        }
+        // If droplet moves off map (or out of its tile in tiled mode), also break
+        if (droplet.pos.m_x < bounds.minX * spacing || droplet.pos.m_x >= bounds.maxX * spacing ||
+            droplet.pos.m_y < bounds.minZ * spacing || droplet.pos.m_y >= bounds.maxZ * spacing) {
+            break;
+            }
 
-                    droplet.sediment -= amountToDeposit;
 
-                    // Convert world pos to grid coord
-                    float gridFloatX = droplet.pos.m_x / spacing;
-                    float gridFloatZ = droplet.pos.m_y / spacing;
+        float newHeight = getHeightAndGradient(heightField, droplet.pos.m_x, droplet.pos.m_y).height;
+        float deltaHeight = newHeight - originalTerrainHeight;
 
-                    int nodeX = static_cast<int>(gridFloatX);
-                    int nodeZ = static_cast<int>(gridFloatZ);
+        // Calculate sediment capacity based on slope, speed and water volume
+        float sedimentCapacity = std::max(-deltaHeight * droplet.speed * droplet.water * m_sedimentCapacityFactor, m_minSedimentCapacity);
 
-                    float cellOffsetX = gridFloatX - nodeX;
-                    float cellOffsetZ = gridFloatZ - nodeZ;
+        writeMinX = std::min(writeMinX, droplet.pos.m_x);
+        writeMinZ = std::min(writeMinZ, droplet.pos.m_y);
+        writeMaxX = std::max(writeMaxX, droplet.pos.m_x);
+        writeMaxZ = std::max(writeMaxZ, droplet.pos.m_y);
 
+        // If carrying more sediment than capacity, deposit sediment
+        if (droplet.sediment > sedimentCapacity || deltaHeight > 0)
+        {
+            // Calculate deposit amount based on height difference or sediment excess
+            float calculated_deposit_amount = 0.0f;
+            if (deltaHeight > 0) {
+                // Original:
+                // calculated_deposit_amount = std::min(deltaHeight, droplet.sediment);
+                // Potentially less aggressive:
+                calculated_deposit_amount = std::min(deltaHeight, droplet.sediment) * m_depositionRate; // Or a new, smaller rate
+            } else {
+                calculated_deposit_amount = (droplet.sediment - sedimentCapacity) * m_depositionRate;
+            }
 
-                    if (nodeX >= 0 && nodeX < width - 1 && nodeZ >= 0 && nodeZ < depth - 1)
-                    {
-                        // Distribute sediment to surrounding grid points using bilinear interpolation
-                        int indexNW = nodeZ * width + nodeX;
-                        int indexNE = indexNW + 1;
-                        int indexSW = indexNW + width;
-                        int indexSE = indexSW + 1;
+            float amountToDeposit = std::max(0.0f, calculated_deposit_amount);
+            amountToDeposit = std::min(amountToDeposit, droplet.sediment);
 
-                        float depositNW = amountToDeposit * (1 - cellOffsetX) * (1 - cellOffsetZ);
-                        float depositNE = amountToDeposit * cellOffsetX * (1 - cellOffsetZ);
-                        float depositSW = amountToDeposit * (1 - cellOffsetX) * cellOffsetZ;
-                        float depositSE = amountToDeposit * cellOffsetX * cellOffsetZ;
+            droplet.sediment -= amountToDeposit;
 
-                        heightGrid[indexNW].m_y += depositNW;
-                        heightGrid[indexNE].m_y += depositNE;
-                        heightGrid[indexSW].m_y += depositSW;
-                        heightGrid[indexSE].m_y += depositSE;
+            depositSediment(heightField, droplet.pos.m_x, droplet.pos.m_y, amountToDeposit);
+        }
+        else
+        {
+            // Calulcate erosion amount based on sediment capacity deficit
+            float amountToErode = std::min((sedimentCapacity - droplet.sediment) * m_erosionRate, -deltaHeight);
+            erodeBrush(heightField, droplet.pos.m_x, droplet.pos.m_y, amountToErode, droplet.sediment);
+        }
 
-                    }
+        // Update droplet speed based on height difference and apply evaporation to reduce pits over time
+        droplet.speed = std::sqrt(std::max(0.0f, droplet.speed * droplet.speed + (-deltaHeight) * m_gravity));
+        droplet.water *= (1.0f - m_evaporationRate);
+        // // Update droplet's speed
+        // //std::cout << "S[" << step << "] EndStepSpeed: " << droplet.speed << ", EndStepWater: " << droplet.water << std::endl;
+        // //std::cout << "S[" << step << "] --- End of Step ---" << std::endl << std::endl;
+    }
 
+    if (writeMinX <= writeMaxX) {
+        dirtyRects.push_back(writeFootprint(heightField, writeMinX, writeMinZ, writeMaxX, writeMaxZ));
+    }
+}
 
+GridRect HydraulicErosion::writeFootprint(const HeightField& heightField, float minWorldX, float minWorldZ,
+                                          float maxWorldX, float maxWorldZ) const
+{
+    const float spacing = heightField.getSpacing();
+    // Deposits reach the next node along each axis, the brush reaches m_brushExtent nodes either side
+    const int before = m_brushExtent;
+    const int after = std::max(m_brushExtent, 1) + 1;
+
+    GridRect rect;
+    rect.minX = std::max(0, static_cast<int>(std::floor(minWorldX / spacing)) - before);
+    rect.minZ = std::max(0, static_cast<int>(std::floor(minWorldZ / spacing)) - before);
+    rect.maxX = std::min(static_cast<int>(heightField.getWidth()), static_cast<int>(maxWorldX / spacing) + after);
+    rect.maxZ = std::min(static_cast<int>(heightField.getDepth()), static_cast<int>(maxWorldZ / spacing) + after);
+    return rect;
+}
+
+namespace
+{
+// Lane-wise getHeightAndGradient. Written as plain loops over fixed size arrays so the compiler
+// emits AVX2/AVX-512 code for it (with gathers for the corner heights) when the target allows,
+// and ordinary scalar code otherwise. gradX/gradZ may be null when only the height is needed.
+void sampleHeightLanes(const HeightField& heightField,
+                       const float* posX,
+                       const float* posZ,
+                       float* height,
+                       float* gradX,
+                       float* gradZ)
+{
+    const int maxX = static_cast<int>(heightField.getWidth()) - 1;
+    const int maxZ = static_cast<int>(heightField.getDepth()) - 1;
+    const int width = static_cast<int>(heightField.getWidth());
+    const float spacing = heightField.getSpacing();
+    const float* heights = heightField.data();
+
+    alignas(64) float hNW[kDropletLanes];
+    alignas(64) float hNE[kDropletLanes];
+    alignas(64) float hSW[kDropletLanes];
+    alignas(64) float hSE[kDropletLanes];
+    alignas(64) float offsetX[kDropletLanes];
+    alignas(64) float offsetZ[kDropletLanes];
+
+    for (int l = 0; l < kDropletLanes; ++l) {
+        float gridFloatX = posX[l] / spacing;
+        float gridFloatZ = posZ[l] / spacing;
+        int coordX = static_cast<int>(std::floor(gridFloatX));
+        int coordZ = static_cast<int>(std::floor(gridFloatZ));
+        offsetX[l] = gridFloatX - coordX;
+        offsetZ[l] = gridFloatZ - coordZ;
+
+        int x0 = std::min(std::max(coordX, 0), maxX);
+        int z0 = std::min(std::max(coordZ, 0), maxZ);
+        int x1 = std::min(std::max(coordX + 1, 0), maxX);
+        int z1 = std::min(std::max(coordZ + 1, 0), maxZ);
+
+        hNW[l] = heights[z0 * width + x0];
+        hNE[l] = heights[z0 * width + x1];
+        hSW[l] = heights[z1 * width + x0];
+        hSE[l] = heights[z1 * width + x1];
+    }
+
+    for (int l = 0; l < kDropletLanes; ++l) {
+        float heightBottom = hNW[l] * (1.0f - offsetX[l]) + hNE[l] * offsetX[l];
+        float heightTop    = hSW[l] * (1.0f - offsetX[l]) + hSE[l] * offsetX[l];
+        height[l] = heightBottom * (1.0f - offsetZ[l]) + heightTop * offsetZ[l];
+    }
+
+    if (gradX == nullptr) { return; }
+
+    for (int l = 0; l < kDropletLanes; ++l) {
+        gradX[l] = (hNE[l] - hNW[l]) * (1.0f - offsetZ[l]) + (hSE[l] - hSW[l]) * offsetZ[l];
+        gradZ[l] = (hSW[l] - hNW[l]) * (1.0f - offsetX[l]) + (hSE[l] - hNE[l]) * offsetX[l];
+    }
+}
+}
+
+void HydraulicErosion::simulateDropletPacket(HeightField& heightField,
+                                             const DropletStart* starts,
+                                             int count,
+                                             int dropletMaxLifetime,
+                                             const DropletBounds& bounds,
+                                             TrailBuffer& trailPoints,
+                                             std::vector<GridRect>& dirtyRects)
+{
+    const float spacing = heightField.getSpacing();
+    const float minX = bounds.minX * spacing;
+    const float minZ = bounds.minZ * spacing;
+    const float maxX = bounds.maxX * spacing;
+    const float maxZ = bounds.maxZ * spacing;
+
+    // Structure of arrays droplet state, one lane per droplet
+    alignas(64) float posX[kDropletLanes];
+    alignas(64) float posZ[kDropletLanes];
+    alignas(64) float dirX[kDropletLanes];
+    alignas(64) float dirZ[kDropletLanes];
+    alignas(64) float speed[kDropletLanes];
+    alignas(64) float water[kDropletLanes];
+    alignas(64) float sediment[kDropletLanes];
+    alignas(64) float height[kDropletLanes];
+    alignas(64) float gradX[kDropletLanes];
+    alignas(64) float gradZ[kDropletLanes];
+    alignas(64) float newHeight[kDropletLanes];
+    alignas(64) float deltaHeight[kDropletLanes];
+    alignas(64) float amount[kDropletLanes];
+    alignas(64) int alive[kDropletLanes];
+    alignas(64) int deposit[kDropletLanes];
+    alignas(64) int record[kDropletLanes];
+
+    // Unused lanes sit on the first droplet's start so their (ignored) samples stay on the grid
+    [[maybe_unused]] int anyRecord = 0;
+    for (int l = 0; l < kDropletLanes; ++l) {
+        record[l] = l < count && starts[l].recordTrail ? 1 : 0;
+        anyRecord |= record[l];
+        const ngl::Vec2& start = starts[l < count ? l : 0].pos;
+        posX[l] = start.m_x;
+        posZ[l] = start.m_y;
+        dirX[l] = 0.0f;
+        dirZ[l] = 0.0f;
+        speed[l] = m_initialSpeed;
+        water[l] = m_initialWaterAmount;
+        sediment[l] = 0.0f;
+        alive[l] = l < count ? 1 : 0;
+    }
+
+    // Range of positions each lane wrote at, lanes can be far apart so they are kept separately
+    float writeMinX[kDropletLanes];
+    float writeMinZ[kDropletLanes];
+    float writeMaxX[kDropletLanes];
+    float writeMaxZ[kDropletLanes];
+    std::fill(writeMinX, writeMinX + kDropletLanes, std::numeric_limits<float>::max());
+    std::fill(writeMinZ, writeMinZ + kDropletLanes, std::numeric_limits<float>::max());
+    std::fill(writeMaxX, writeMaxX + kDropletLanes, std::numeric_limits<float>::lowest());
+    std::fill(writeMaxZ, writeMaxZ + kDropletLanes, std::numeric_limits<float>::lowest());
+
+    for (int step = 0; step < dropletMaxLifetime; ++step)
+    {
+        // Every lane starts together, so the remaining lifetime is shared by the packet
+        const int lifetime = dropletMaxLifetime - step;
+
+        int anyAlive = 0;
+        for (int l = 0; l < kDropletLanes; ++l) { anyAlive |= alive[l]; }
+        if (!anyAlive) { break; }
+
+        sampleHeightLanes(heightField, posX, posZ, height, gradX, gradZ);
+
+        // Update direction from inertia and gradient, normalise and move one unit
+        for (int l = 0; l < kDropletLanes; ++l) {
+            float newDirX = dirX[l] * m_inertiaFactor - gradX[l] * (1 - m_inertiaFactor);
+            float newDirZ = dirZ[l] * m_inertiaFactor - gradZ[l] * (1 - m_inertiaFactor);
+            float length = std::sqrt(newDirX * newDirX + newDirZ * newDirZ);
+            newDirX = length != 0.0f ? newDirX / length : newDirX;
+            newDirZ = length != 0.0f ? newDirZ / length : newDirZ;
+
+            dirX[l] = alive[l] ? newDirX : dirX[l];
+            dirZ[l] = alive[l] ? newDirZ : dirZ[l];
+            posX[l] = alive[l] ? posX[l] + newDirX : posX[l];
+            posZ[l] = alive[l] ? posZ[l] + newDirZ : posZ[l];
+        }
+
+#if TERRAIN_RECORD_TRAILS
+        if (anyRecord) {
+            for (int l = 0; l < kDropletLanes; ++l) {
+                if (alive[l] && record[l]) {
+                    trailPoints.push(ngl::Vec4(posX[l], height[l], posZ[l], static_cast<float>(lifetime)));
                 }
-                else
-                {
-                    // Calulcate erosion amount based on sediment capacity deficit
-                    float amountToErode = std::min((sedimentCapacity - droplet.sediment) * m_erosionRate, -deltaHeight);
-                    // Get current cell coord
-                    int currentCellGridX = static_cast<int>(droplet.pos.m_x / spacing);
-                    int currentCellGridZ = static_cast<int>(droplet.pos.m_y / spacing); // Assuming droplet.pos.m_y is world Z
-                    // Clamp to valid grid range
-                    currentCellGridX = std::max(0, std::min(currentCellGridX, (int)width - 1));
-                    currentCellGridZ = std::max(0, std::min(currentCellGridZ, (int)depth - 1));
-                    int brushAccessIndex = currentCellGridZ * width + currentCellGridX;
-
-                    if (brushAccessIndex >= 0 && brushAccessIndex <= m_brushIndices.size())
-                        { // Check bounds
-                        //Apply erosion to all points within brush radius using precaculated weights
-                        const std::vector<int>& indices = m_brushIndices[brushAccessIndex];
-                        const std::vector<float>& weights = m_brushWeights[brushAccessIndex];
-                        for (size_t i = 0; i < indices.size(); i++) {
-
-                            int nodeIndex = indices[i];
-                            float weight = weights[i];
-
-                            float erosion = amountToErode * weight;
-                            float actualErosion = std::min(heightGrid[nodeIndex].m_y, erosion);
-                            heightGrid[nodeIndex].m_y -= actualErosion;
-                            droplet.sediment += actualErosion;
-                        }
-                    } else {
-                        // Handle case where brushAccessIndex is out of bounds, though clamping should prevent this
-                        //std::cout << "Error: Brush access index out of bounds!" << std::endl;
-                        continue; // Skip erosion for this step if brush can't be found
-                    }
-                }
+            }
+        }
+#endif
+
+        // Mask out droplets that ran out of time or water, or left their bounds
+        for (int l = 0; l < kDropletLanes; ++l) {
+            bool inside = posX[l] >= minX && posX[l] < maxX && posZ[l] >= minZ && posZ[l] < maxZ;
+            bool finished = lifetime - 1 <= 0 || water[l] <= 0.1f || !inside;
+            alive[l] = alive[l] && !finished;
+        }
+
+        sampleHeightLanes(heightField, posX, posZ, newHeight, nullptr, nullptr);
 
-                // Update droplet speed based on height difference and apply evaporation to reduce pits over time
-                droplet.speed = std::sqrt(std::max(0.0f, droplet.speed * droplet.speed + (-deltaHeight) * m_gravity));
-                droplet.water *= (1.0f - m_evaporationRate);
-                // // Update droplet's speed
-                // //std::cout << "S[" << step << "] EndStepSpeed: " << droplet.speed << ", EndStepWater: " << droplet.water << std::endl;
-                // //std::cout << "S[" << step << "] --- End of Step ---" << std::endl << std::endl;
+        // Capacity and the amount to deposit or erode, same rules as simulateDroplet
+        for (int l = 0; l < kDropletLanes; ++l) {
+            deltaHeight[l] = newHeight[l] - height[l];
+            float sedimentCapacity = std::max(-deltaHeight[l] * speed[l] * water[l] * m_sedimentCapacityFactor, m_minSedimentCapacity);
+            deposit[l] = (sediment[l] > sedimentCapacity || deltaHeight[l] > 0) ? 1 : 0;
+
+            float depositAmount = deltaHeight[l] > 0 ? std::min(deltaHeight[l], sediment[l]) * m_depositionRate
+                                                     : (sediment[l] - sedimentCapacity) * m_depositionRate;
+            depositAmount = std::min(std::max(0.0f, depositAmount), sediment[l]);
+            float erodeAmount = std::min((sedimentCapacity - sediment[l]) * m_erosionRate, -deltaHeight[l]);
+            amount[l] = deposit[l] ? depositAmount : erodeAmount;
+        }
+
+        // Scatter into the height field one lane at a time, lanes may share nodes
+        for (int l = 0; l < kDropletLanes; ++l) {
+            if (!alive[l]) { continue; }
+            writeMinX[l] = std::min(writeMinX[l], posX[l]);
+            writeMinZ[l] = std::min(writeMinZ[l], posZ[l]);
+            writeMaxX[l] = std::max(writeMaxX[l], posX[l]);
+            writeMaxZ[l] = std::max(writeMaxZ[l], posZ[l]);
+            if (deposit[l]) {
+                sediment[l] -= amount[l];
+                depositSediment(heightField, posX[l], posZ[l], amount[l]);
+            } else {
+                erodeBrush(heightField, posX[l], posZ[l], amount[l], sediment[l]);
             }
         }
+
+        for (int l = 0; l < kDropletLanes; ++l) {
+            float newSpeed = std::sqrt(std::max(0.0f, speed[l] * speed[l] + (-deltaHeight[l]) * m_gravity));
+            speed[l] = alive[l] ? newSpeed : speed[l];
+            water[l] = alive[l] ? water[l] * (1.0f - m_evaporationRate) : water[l];
+        }
+    }
+
+    for (int l = 0; l < count; ++l) {
+        if (writeMinX[l] <= writeMaxX[l]) {
+            dirtyRects.push_back(writeFootprint(heightField, writeMinX[l], writeMinZ[l], writeMaxX[l], writeMaxZ[l]));
+        }
+    }
+}
+
+void HydraulicErosion::depositSediment(HeightField& heightField, float worldX, float worldZ, float amountToDeposit) const
+{
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    const float spacing = heightField.getSpacing();
+
+    // Convert world pos to grid coord
+    float gridFloatX = worldX / spacing;
+    float gridFloatZ = worldZ / spacing;
+
+    int nodeX = static_cast<int>(gridFloatX);
+    int nodeZ = static_cast<int>(gridFloatZ);
+
+    float cellOffsetX = gridFloatX - nodeX;
+    float cellOffsetZ = gridFloatZ - nodeZ;
+
+
+    if (nodeX >= 0 && nodeX < static_cast<int>(width) - 1 && nodeZ >= 0 && nodeZ < static_cast<int>(depth) - 1)
+    {
+        // Distribute sediment to surrounding grid points using bilinear interpolation
+        int indexNW = nodeZ * width + nodeX;
+        int indexNE = indexNW + 1;
+        int indexSW = indexNW + width;
+        int indexSE = indexSW + 1;
+
+        float depositNW = amountToDeposit * (1 - cellOffsetX) * (1 - cellOffsetZ);
+        float depositNE = amountToDeposit * cellOffsetX * (1 - cellOffsetZ);
+        float depositSW = amountToDeposit * (1 - cellOffsetX) * cellOffsetZ;
+        float depositSE = amountToDeposit * cellOffsetX * cellOffsetZ;
+
+        heightField[indexNW] += depositNW;
+        heightField[indexNE] += depositNE;
+        heightField[indexSW] += depositSW;
+        heightField[indexSE] += depositSE;
+    }
+}
+
+void HydraulicErosion::erodeBrush(HeightField& heightField, float worldX, float worldZ, float amountToErode, float& sediment) const
+{
+    const int width = static_cast<int>(heightField.getWidth());
+    const int depth = static_cast<int>(heightField.getDepth());
+    const float spacing = heightField.getSpacing();
+
+    // Get current cell coord
+    int currentCellGridX = static_cast<int>(worldX / spacing);
+    int currentCellGridZ = static_cast<int>(worldZ / spacing);
+    // Clamp to valid grid range
+    currentCellGridX = std::max(0, std::min(currentCellGridX, width - 1));
+    currentCellGridZ = std::max(0, std::min(currentCellGridZ, depth - 1));
+
+    //Apply erosion to all points within brush radius using the shared stencil
+    const int centerIndex = currentCellGridZ * width + currentCellGridX;
+    auto erodeNode = [&](int nodeIndex, float weight) {
+        float erosion = amountToErode * weight;
+        float actualErosion = std::min(heightField[nodeIndex], erosion);
+        heightField[nodeIndex] -= actualErosion;
+        sediment += actualErosion;
+    };
+
+    const int extent = m_brushExtent;
+    if (currentCellGridX >= extent && currentCellGridX + extent < width &&
+        currentCellGridZ >= extent && currentCellGridZ + extent < depth)
+    {
+        // Whole stencil is on the grid, no per node bounds checks
+        for (size_t i = 0; i < m_brushWeights.size(); i++) {
+            erodeNode(centerIndex + m_brushIndexOffsets[i], m_brushWeights[i]);
+        }
+    }
+    else
+    {
+        // Near the border only the part of the stencil still on the grid is applied
+        for (size_t i = 0; i < m_brushWeights.size(); i++) {
+            int nx = currentCellGridX + m_brushOffsetX[i];
+            int nz = currentCellGridZ + m_brushOffsetZ[i];
+            if (nx >= 0 && nx < width && nz >= 0 && nz < depth) {
+                erodeNode(nz * width + nx, m_brushWeights[i]);
+            }
+        }
+    }
+}
+
+void HydraulicErosion::dropletStartCell(std::uint64_t dropletIndex,
+                                        unsigned int width,
+                                        unsigned int depth,
+                                        int& gridX,
+                                        int& gridZ) const
+{
+    // Same range as the old ngl::Random::randomPositiveNumber(width - 1) start, one stream per axis
+    gridX = static_cast<int>(m_random.uniform(dropletIndex, 0) * static_cast<float>(width - 1));
+    gridZ = static_cast<int>(m_random.uniform(dropletIndex, 1) * static_cast<float>(depth - 1));
 }
 
 HeightAndGradientData HydraulicErosion::getHeightAndGradient(
-    const std::vector<ngl::Vec3>& heightGrid,
-    unsigned int width,
-    unsigned int depth,
-    float spacing,
+    const HeightField& heightField,
     float worldX,
     float worldZ) const {
     // Implementation moved from Plane::getHeightAndGradient
     HeightAndGradientData result;
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    const float spacing = heightField.getSpacing();
 
     // Convert world coord to grid
     float gridFloatZ = worldZ / spacing;
@@ -208,10 +675,10 @@ HeightAndGradientData HydraulicErosion::getHeightAndGradient(
 
     // Calculate heights of the four nodes of the droplet's cell
     // index = z * m_width + x
-    float hNW = heightGrid[c_z0 * width + c_x0].m_y;
-    float hNE = heightGrid[c_z0 * width + c_x1].m_y;
-    float hSW = heightGrid[c_z1 * width + c_x0].m_y;
-    float hSE = heightGrid[c_z1 * width + c_x1].m_y;
+    float hNW = heightField[c_z0 * width + c_x0];
+    float hNE = heightField[c_z0 * width + c_x1];
+    float hSW = heightField[c_z1 * width + c_x0];
+    float hSE = heightField[c_z1 * width + c_x1];
 
     // Calculate droplet's direction of flow (gradient) with bilinear interpolation of height difference along the edges
     // This is the gradient of ascent
@@ -229,15 +696,16 @@ HeightAndGradientData HydraulicErosion::getHeightAndGradient(
 
 
 void HydraulicErosion::computeAreaOfInfluence(unsigned int width, unsigned int depth, float radius) {
-    int centerX = width / 2;
-    int centerY = depth / 2;
-
-    m_brushIndices.resize(width * depth);
-    m_brushWeights.resize(width * depth);
+    // The stencil is shared by every cell and kept between erode() calls,
+    // it only needs rebuilding when the grid dimensions or the radius change
+    if (!m_brushWeights.empty() && m_brushRadius == radius && m_brushWidth == width && m_brushDepth == depth) {
+        return;
+    }
 
-    std::vector<int> relativeX;
-    std::vector<int> relativeY;
-    std::vector<float> unnormalizedWeights;
+    m_brushOffsetX.clear();
+    m_brushOffsetZ.clear();
+    m_brushWeights.clear();
+    m_brushExtent = 0;
 
     float weightSum = 0.0f;
 
@@ -250,40 +718,27 @@ void HydraulicErosion::computeAreaOfInfluence(unsigned int width, unsigned int d
                 float distance = std::sqrt(distanceSquared);
                 float weight = 1.0f - (distance / radius); // stronger near center
 
-                relativeX.push_back(offsetX);
-                relativeY.push_back(offsetY);
-                unnormalizedWeights.push_back(weight);
+                m_brushOffsetX.push_back(offsetX);
+                m_brushOffsetZ.push_back(offsetY);
+                m_brushWeights.push_back(weight);
+                m_brushExtent = std::max(m_brushExtent, std::max(std::abs(offsetX), std::abs(offsetY)));
                 weightSum += weight;
             }
         }
     }
 
     // Normalize weights
-    for (float& weight : unnormalizedWeights) {
+    for (float& weight : m_brushWeights) {
         weight /= weightSum;
     }
 
-    // Apply that pattern to each cell on the grid
-    for (int y = 0; y < depth; ++y) {
-        for (int x = 0; x < width; ++x) {
-            int centerIndex = y * width + x;
-
-            std::vector<int>& indices = m_brushIndices[centerIndex];
-            std::vector<float>& weights = m_brushWeights[centerIndex];
-            indices.clear();
-            weights.clear();
-
-            // Store valid grid indices and their weights for this center point
-            for (size_t i = 0; i < relativeX.size(); ++i) {
-                int nx = x + relativeX[i];
-                int ny = y + relativeY[i];
-
-                if (nx >= 0 && nx < width && ny >= 0 && ny < depth) {
-                    int index = ny * width + nx;
-                    indices.push_back(index);
-                    weights.push_back(unnormalizedWeights[i]);
-                }
-            }
-        }
+    // Flattened offsets for interior cells, these depend on the row length
+    m_brushIndexOffsets.resize(m_brushWeights.size());
+    for (size_t i = 0; i < m_brushWeights.size(); ++i) {
+        m_brushIndexOffsets[i] = m_brushOffsetZ[i] * static_cast<int>(width) + m_brushOffsetX[i];
     }
+
+    m_brushRadius = radius;
+    m_brushWidth = width;
+    m_brushDepth = depth;
 }
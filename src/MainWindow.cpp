@@ -39,6 +39,13 @@ MainWindow::MainWindow(QWidget *parent)
                     });
 
 
+        // Seed
+            connect(m_ui->seedSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+                    this, [this](int value) {
+                            m_gl->updateTerrainSeed(value);
+                    });
+
+
         // Depth
             connect(m_ui->widthHorizontalSlider, &QSlider::valueChanged,
                     this, [this](int value) {
@@ -63,6 +70,31 @@ MainWindow::MainWindow(QWidget *parent)
                             m_ratioLocked = (state == Qt::Checked);
                         });
 
+        // Erosion model
+            connect(m_ui->erosionModelComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+                    this, [this](int index) {
+                            m_gl->updateErosionModel(index);
+                    });
+
+        // Coarse to fine erosion for any model
+            connect(m_ui->erosionPyramidCheckBox, &QCheckBox::stateChanged,
+                    this, [this](int state) {
+                            m_gl->updateErosionPyramid(state == Qt::Checked);
+                    });
+
+        // Background erosion progress, the erode button cancels while a run is going
+            connect(m_gl, &NGLScene::erosionProgress,
+                    this, [this](int done, int total) {
+                            m_ui->statusbar->showMessage(QString("Eroding %1 / %2").arg(done).arg(total));
+                    });
+            connect(m_gl, &NGLScene::erosionRunningChanged,
+                    this, [this](bool running) {
+                            m_ui->erodeButton->setText(running ? "Cancel" : "Erode");
+                            if (!running) {
+                                m_ui->statusbar->showMessage("Erosion finished", 3000);
+                            }
+                    });
+
     });
 }
 
@@ -90,6 +122,10 @@ void MainWindow::on_lifetimeDial_valueChanged(int value)
 
 void MainWindow::on_erodeButton_clicked()
 {
+    if (m_gl->isEroding()) {
+        m_gl->cancelErosion();
+        return;
+    }
     m_gl->callErosionEvent(maxDroplets,lifetime);
 }
 
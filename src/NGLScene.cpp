@@ -7,9 +7,11 @@
 #include <ngl/Transformation.h>
 #include <ngl/Util.h>
 #include <iostream>
-#include <QApplication>
-#include <QCoreApplication> // For QCoreApplication::processEvents()
+#include <QThread>
 #include <ngl/VAOFactory.h>
+#include "PyramidErosion.h"
+#include "ShallowWaterErosion.h"
+#include "ThermalErosion.h"
 
 NGLScene::NGLScene(QWidget *_parent) :QOpenGLWidget(_parent)
 {
@@ -19,6 +21,7 @@ NGLScene::NGLScene(QWidget *_parent) :QOpenGLWidget(_parent)
 
 NGLScene::~NGLScene()
 {
+    stopErosion(false);
     //std::cout<<"Shutting down NGL, removing VAO's and Shaders\n";
 }
 
@@ -46,9 +49,12 @@ void NGLScene::initializeGL()
   m_emitter=std::make_unique<DropletVisualize>(10000,10000,800,ngl::Vec3(0,0,0));
 
   m_plane = std::make_unique<Plane>(300, 300, 1.0f);
+  configureErosion();
 
   ngl::ShaderLib::loadShader("HeightColourShader","shaders/HeightColourVertex.glsl","shaders/HeightColourFragment.glsl");
+  ngl::ShaderLib::loadShader("HeightGridShader","shaders/HeightGridVertex.glsl","shaders/HeightColourFragment.glsl");
     ngl::ShaderLib::loadShader("ColourShader","shaders/ColourVertex.glsl","shaders/ColourFragment.glsl");
+  ngl::ShaderLib::loadShader("TrailShader","shaders/TrailVertex.glsl","shaders/ColourFragment.glsl");
 
 
   m_view = ngl::lookAt({150.0f, 100.0f, 450.0f}, {150.0f, 0.0f, 150.0f}, {0.0f, 1.0f, 0.0f});
@@ -72,16 +78,35 @@ void NGLScene::paintGL()
   mouseRotation.m_m[3][0]=m_modelPos.m_x;
   mouseRotation.m_m[3][1]=m_modelPos.m_y;
   mouseRotation.m_m[3][2]=m_modelPos.m_z;
-  ngl::ShaderLib::use("HeightColourShader");
+  // The height-only stream rebuilds x/z in the shader from the grid width and spacing
+  const bool heightOnly = m_plane->getVertexFormat() == TerrainVertexFormat::Height;
+  ngl::ShaderLib::use(heightOnly ? "HeightGridShader" : "HeightColourShader");
   ngl::ShaderLib::setUniform("MVP",m_project*m_view*mouseRotation);
   ngl::ShaderLib::setUniform("maxTerrainHeight", m_plane->getTerrainHeight());
+  if (heightOnly)
+  {
+    ngl::ShaderLib::setUniform("gridWidth", m_plane->getWidth());
+    ngl::ShaderLib::setUniform("gridSpacing", m_plane->getSpacing());
+  }
 
  // Wireframe switch
   glPolygonMode(GL_FRONT_AND_BACK, m_wireframeMode ? GL_LINE : GL_FILL);
-  m_plane->render();
+  if (m_plane->isLodEnabled())
+  {
+    // Eye position in the terrain's model space for the per chunk LOD distances
+    ngl::Mat4 modelView = m_view*mouseRotation;
+    ngl::Vec3 eye = (modelView.inverse()*ngl::Vec4(0.0f, 0.0f, 0.0f, 1.0f)).toVec3();
+    m_plane->renderLOD(eye, m_project*modelView);
+  }
+  else
+  {
+    m_plane->render();
+  }
 
-  ngl::ShaderLib::use("ColourShader");
+  ngl::ShaderLib::use("TrailShader");
   ngl::ShaderLib::setUniform("MVP",m_project*m_view*mouseRotation);
+  ngl::ShaderLib::setUniform("pointSize",3.0f);
+  ngl::ShaderLib::setUniform("trailAlpha",0.1f);
 
   m_emitter->drawTrailPoints(m_plane->getDropletTrailPoints());
 
@@ -131,27 +156,14 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
    case Qt::Key_E :
         if (m_plane)
         {
-
-            const int totalDroplets = 40000;
-            const int dropletsPerUpdate = 1000;
-            const int iterations = totalDroplets / dropletsPerUpdate; // 40 iterations
-
-            for (int i = 0; i < iterations; i++)
-            {
-                // Apply erosion for just dropletsPerUpdate droplets
-                m_plane->applyHydraulicErosion(dropletsPerUpdate, 30);
-                makeCurrent();
-                m_plane->refreshGPUAssets();
-
-                update();
-                QApplication::processEvents();
-
-            }
-            doneCurrent(); // Release context for the FINAL GPU update
-
+            callErosionEvent(40000, 30);
         }
         break;
 
+   case Qt::Key_Escape :
+        cancelErosion();
+        break;
+
           case Qt::Key_W :
 
         if (m_plane)
@@ -160,6 +172,27 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
                   update();
                   break;
         }
+          case Qt::Key_H:
+              // Toggle between the height-only and the full position vertex stream
+              if (m_plane)
+              {
+                  makeCurrent();
+                  m_plane->setVertexFormat(m_plane->getVertexFormat() == TerrainVertexFormat::Height
+                                               ? TerrainVertexFormat::Position : TerrainVertexFormat::Height);
+                  doneCurrent();
+                  update();
+              }
+              break;
+          case Qt::Key_L:
+              // Toggle the chunked level of detail renderer
+              if (m_plane)
+              {
+                  makeCurrent();
+                  m_plane->setLodEnabled(!m_plane->isLodEnabled());
+                  doneCurrent();
+                  update();
+              }
+              break;
           case Qt::Key_V:
               m_emitter->setShowTrailPoints(!m_emitter->isShowingTrailPoints());
               update();
@@ -209,6 +242,8 @@ void NGLScene::setSpread(double _value)
 
 void NGLScene::updateGridDepth(int depth)
 {
+    // A new terrain makes the running erosion meaningless
+    stopErosion(false);
     if (m_plane) {
         m_plane->setDepth(depth);
         makeCurrent();
@@ -221,6 +256,7 @@ void NGLScene::updateGridDepth(int depth)
 
 void NGLScene::updateGridWidth(int width)
 {
+    stopErosion(false);
     if (m_plane) {
         m_plane->setWidth(width);
         makeCurrent();
@@ -232,6 +268,7 @@ void NGLScene::updateGridWidth(int width)
 }
 void NGLScene::updateTerrainFrequency(float freq)
 {
+    stopErosion(false);
     if (m_plane) {
         m_plane->setNoiseFrequency(freq);
         makeCurrent();
@@ -243,6 +280,7 @@ void NGLScene::updateTerrainFrequency(float freq)
 }
 void NGLScene::updateTerrainOctaves(int octaves)
 {
+    stopErosion(false);
     if (m_plane) {
         m_plane->setNoiseOctaves(octaves);
         makeCurrent();
@@ -253,8 +291,22 @@ void NGLScene::updateTerrainOctaves(int octaves)
 
     }
 }
+void NGLScene::updateTerrainSeed(int seed)
+{
+    stopErosion(false);
+    if (m_plane) {
+        m_plane->setNoiseSeed(static_cast<std::uint32_t>(seed));
+        makeCurrent();
+        m_plane->regenerate();
+        doneCurrent();
+
+        update();
+
+    }
+}
 void NGLScene::updateTerrainHeight(int height)
 {
+    stopErosion(false);
     if (m_plane) {
         m_plane->setTerrainHeight(height);
         makeCurrent();
@@ -268,27 +320,119 @@ void NGLScene::updateTerrainHeight(int height)
     }
 }
 
-void NGLScene::callErosionEvent(int maxDroplets, int lifetime)
+void NGLScene::updateErosionModel(int index)
 {
-    if (m_plane)
+    // A run in progress belongs to the old model, keep what it finished
+    stopErosion(true);
+    if (m_plane) {
+        if (index == 1) {
+            m_plane->setErosionModel(std::make_shared<ShallowWaterErosion>());
+        } else if (index == 2) {
+            m_plane->setErosionModel(std::make_shared<ThermalErosion>());
+        } else {
+            m_plane->setErosionModel(std::make_shared<HydraulicErosion>());
+        }
+        configureErosion();
+        std::cout << "Erosion model " << m_plane->getErosionModel().getName() << std::endl;
+
+        update();
+    }
+}
+
+void NGLScene::configureErosion()
+{
+    // Erode on every core using 64x64 checkerboard tiles
+    m_plane->setErosionThreading(0, 64);
+    m_plane->setErosionBatched(true);
+    // A few talus sweeps per 1000 droplets flatten droplet spikes steeper than the noise itself makes
+    m_plane->setErosionTalus(4, 2.0f);
+    m_plane->setErosionPyramid(m_erosionPyramid ? PyramidErosion::kDefaultLevels : 0);
+}
+
+void NGLScene::updateErosionPyramid(bool enabled)
+{
+    stopErosion(true);
+    m_erosionPyramid = enabled;
+    if (m_plane) {
+        m_plane->setErosionPyramid(enabled ? PyramidErosion::kDefaultLevels : 0);
+        std::cout << "Erosion model " << m_plane->getErosionModel().getName() << std::endl;
+    }
+}
+
+void NGLScene::callErosionEvent(int iterations, int lifetime)
+{
+    if (!m_plane)
     {
-        std::cout << "Erosion droplets " << maxDroplets << std::endl;
-        std::cout << "Droplet Lifetime " << lifetime << std::endl;
+        return;
+    }
+    stopErosion(true);
 
+    std::cout << "Erosion " << m_plane->getErosionModel().getName() << " iterations " << iterations << std::endl;
+    std::cout << "Droplet Lifetime " << lifetime << std::endl;
 
-        const int dropletsPerUpdate = 1000;
-        const int iterations = maxDroplets / dropletsPerUpdate; // 40 iterations
+    m_plane->setDropletLifetime(lifetime);
+    m_erosionThread = new QThread(this);
+    m_erosionWorker = new ErosionWorker(m_plane->getHeightField(), m_plane->getErosionModel(), iterations);
+    m_erosionWorker->moveToThread(m_erosionThread);
 
-        for (int i = 0; i < iterations; i++)
-        {
-            m_plane->applyHydraulicErosion(dropletsPerUpdate, 30);
-            makeCurrent();
-            m_plane->refreshGPUAssets();
+    // Worker signals arrive queued on the GUI thread
+    connect(m_erosionThread, &QThread::started, m_erosionWorker, &ErosionWorker::run);
+    connect(m_erosionWorker, &ErosionWorker::progress, this, &NGLScene::erosionProgress);
+    connect(m_erosionWorker, &ErosionWorker::snapshotReady, this, &NGLScene::applyErosionSnapshot);
+    connect(m_erosionWorker, &ErosionWorker::finished, this, &NGLScene::erosionFinished);
 
-            update();
-            QApplication::processEvents();
+    m_erosionThread->start();
+    emit erosionRunningChanged(true);
+}
 
-        }
-        doneCurrent(); // Release context for the FINAL GPU update
+void NGLScene::cancelErosion()
+{
+    stopErosion(true);
+}
+
+void NGLScene::applyErosionSnapshot()
+{
+    // Several snapshotReady signals can be queued behind a slow frame, only the newest is taken
+    if (!m_erosionWorker || !m_plane || !m_erosionWorker->takeSnapshot(m_erosionSnapshot))
+    {
+        return;
+    }
+    makeCurrent();
+    m_plane->applyErosionSnapshot(m_erosionSnapshot.heightField,
+                                  m_erosionSnapshot.trailPoints,
+                                  m_erosionSnapshot.dropletCounter,
+                                  m_erosionSnapshot.dirtyTiles);
+    doneCurrent();
+    update();
+}
+
+void NGLScene::erosionFinished()
+{
+    stopErosion(true);
+}
+
+void NGLScene::stopErosion(bool keepResult)
+{
+    if (!m_erosionThread)
+    {
+        return;
+    }
+
+    m_erosionWorker->cancel();
+    m_erosionThread->quit();
+    m_erosionThread->wait();
+
+    // The worker always publishes its final state before run() returns
+    if (keepResult)
+    {
+        applyErosionSnapshot();
     }
+
+    disconnect(m_erosionWorker, nullptr, this, nullptr);
+    delete m_erosionWorker;
+    delete m_erosionThread;
+    m_erosionWorker = nullptr;
+    m_erosionThread = nullptr;
+    m_erosionSnapshot.trailPoints.clear();
+    emit erosionRunningChanged(false);
 }
@@ -5,38 +5,224 @@
 
 #include "PerlinNoiseGenerator.h"
 #include "PerlinNoise.hpp"
+#include "PerlinRow.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
-PerlinNoiseGenerator::PerlinNoiseGenerator(float frequency, int octaves, int maxHeight)
-    : m_frequency(frequency), m_octaves(octaves), m_maxHeight(maxHeight)
+PerlinNoiseGenerator::PerlinNoiseGenerator(float frequency, int octaves, int maxHeight, std::uint32_t seed)
+    : m_frequency(frequency), m_octaves(octaves), m_maxHeight(maxHeight), m_seed(seed), m_perlin(seed)
 {
     // Constructor implementation
 }
 
-void PerlinNoiseGenerator::generateTerrain(std::vector<ngl::Vec3>& heightGrid,
-                                          unsigned int width,
-                                          unsigned int depth,
-                                          float spacing, int maxHeight)
+void PerlinNoiseGenerator::setSeed(std::uint32_t seed)
 {
-    if (heightGrid.empty()) {
+    if (seed == m_seed) {
         return;
     }
+    m_seed = seed;
+    m_perlin.reseed(seed);
+}
+
+void PerlinNoiseGenerator::setOctaveCacheBudget(std::size_t bytes)
+{
+    m_octaveCacheBudget = bytes;
+    if (bytes == 0) {
+        m_octaveLayers.clear();
+    }
+}
+
+void PerlinNoiseGenerator::validateOctaveCache(unsigned int width, unsigned int depth, float spacing)
+{
+    if (width == m_cacheWidth && depth == m_cacheDepth && spacing == m_cacheSpacing &&
+        m_frequency == m_cacheFrequency && m_seed == m_cacheSeed) {
+        return;
+    }
+    m_octaveLayers.clear();
+    m_cacheWidth = width;
+    m_cacheDepth = depth;
+    m_cacheSpacing = spacing;
+    m_cacheFrequency = m_frequency;
+    m_cacheSeed = m_seed;
+}
+
+std::vector<int> PerlinNoiseGenerator::chooseOctaveLayers(int octaves, int firstNew, std::size_t cells) const
+{
+    std::vector<int> candidates;
+    for (const auto& layer : m_octaveLayers) {
+        candidates.push_back(layer.first);
+    }
+    for (int count = firstNew; count <= octaves; ++count) {
+        candidates.push_back(count);
+    }
+
+    // Nearest to the current count first, the lower one on a tie since removing an octave needs it
+    std::sort(candidates.begin(), candidates.end(), [octaves](int a, int b) {
+        const int distanceA = std::abs(a - octaves);
+        const int distanceB = std::abs(b - octaves);
+        return distanceA != distanceB ? distanceA < distanceB : a < b;
+    });
+    const std::size_t layerBytes = cells * sizeof(double);
+    const std::size_t maxLayers = layerBytes == 0 ? 0 : m_octaveCacheBudget / layerBytes;
+    // The current sum is always kept while the cache is on, even if it alone is over budget
+    const std::size_t keep = m_octaveCacheBudget == 0 ? 0 : std::max<std::size_t>(1, maxLayers);
+    candidates.resize(std::min(keep, candidates.size()));
+    return candidates;
+}
+
+void PerlinNoiseGenerator::generateTerrain(HeightField& heightField, int maxHeight)
+{
+    if (heightField.empty()) {
+        return;
+    }
+
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    const float spacing = heightField.getSpacing();
+    const std::size_t cells = heightField.size();
+    // octave2D runs no octaves for a count below 1
+    const int octaves = std::max(0, m_octaves);
+
+    validateOctaveCache(width, depth, spacing);
+
+    // Start from the largest cached sum that doesn't exceed the octave count,
+    // with a cached sum for exactly this count no noise is evaluated at all
+    int baseOctaves = 0;
+    const double* baseSums = nullptr;
+    auto base = m_octaveLayers.upper_bound(octaves);
+    if (base != m_octaveLayers.begin()) {
+        --base;
+        baseOctaves = base->first;
+        baseSums = base->second.data();
+    }
 
-    const siv::PerlinNoise::seed_type seed = 123456u;
-    const siv::PerlinNoise perlin{seed};
+    // Allocate the new sums that will be kept and drop cached ones that won't
+    const std::vector<int> keep = chooseOctaveLayers(octaves, baseOctaves + 1, cells);
+    std::vector<double*> newLayers(static_cast<std::size_t>(octaves + 1), nullptr);
+    for (int count : keep) {
+        if (count > baseOctaves && count <= octaves) {
+            std::vector<double>& layer = m_octaveLayers[count];
+            layer.resize(cells);
+            newLayers[count] = layer.data();
+        }
+    }
+    for (auto layer = m_octaveLayers.begin(); layer != m_octaveLayers.end();) {
+        const bool kept = std::find(keep.begin(), keep.end(), layer->first) != keep.end();
+        // The base is still read below, it goes after the rows are done
+        if (!kept && layer->first != baseOctaves) {
+            layer = m_octaveLayers.erase(layer);
+        } else {
+            ++layer;
+        }
+    }
+
+    const siv::PerlinNoise& perlin = m_perlin;
     float planeTotalWidth = (width > 1) ? (width - 1) * spacing : 1.0f;
     float planeTotalDepth = (depth > 1) ? (depth - 1) * spacing : 1.0f;
     if (planeTotalWidth == 0.0f) planeTotalWidth = 1.0f;
     if (planeTotalDepth == 0.0f) planeTotalDepth = 1.0f;
 
-    for (ngl::Vec3& vertex : heightGrid)
+    // The noise x of every column is the same on each row, work it out once
+    std::vector<double> noiseX(width);
+    for (unsigned int x = 0; x < width; ++x)
     {
-        float current_x_pos = vertex.m_x;
-        float current_z_pos = vertex.m_z;
+        float current_x_pos = x * spacing;
         float noiseInputX = (width == 1) ? 0.0f : current_x_pos / planeTotalWidth;
-        float noiseInputZ = (depth == 1) ? 0.0f : current_z_pos / planeTotalDepth;
-        float height_normalized = std::abs(perlin.octave2D_01(noiseInputX * m_frequency,
-                                                   noiseInputZ * m_frequency,
-                                                   m_octaves, 0.5));
-        vertex.m_y = height_normalized * maxHeight;
+        noiseX[x] = noiseInputX * m_frequency;
+    }
+
+    // Every row only reads the shared noise state and writes its own heights,
+    // so bands of rows run in parallel and give the same result as one thread
+    const unsigned int bands = (depth + kRowsPerTask - 1) / kRowsPerTask;
+    parallelFor(bands, m_threadCount, [&](std::size_t band) {
+        std::vector<double> noise(width);
+        const unsigned int firstRow = static_cast<unsigned int>(band) * kRowsPerTask;
+        const unsigned int lastRow = std::min(firstRow + kRowsPerTask, depth);
+        for (unsigned int z = firstRow; z < lastRow; ++z)
+        {
+            float* heights = heightField.row(z);
+            float current_z_pos = z * spacing;
+            float noiseInputZ = (depth == 1) ? 0.0f : current_z_pos / planeTotalDepth;
+            const std::size_t rowStart = static_cast<std::size_t>(z) * width;
+
+            // Only the octaves past the cached sum are evaluated, one at a time so every
+            // kept count can store its sum. Same values as octave2D_01 per vertex.
+            if (baseSums) {
+                std::copy(baseSums + rowStart, baseSums + rowStart + width, noise.begin());
+            } else {
+                std::fill(noise.begin(), noise.end(), 0.0);
+            }
+            for (int octave = baseOctaves; octave < octaves; ++octave)
+            {
+                addOctaves2DRow(perlin, noiseX.data(), noiseInputZ * m_frequency, static_cast<int>(width),
+                                octave, 1, 0.5, noise.data());
+                if (double* layer = newLayers[octave + 1]) {
+                    std::copy(noise.begin(), noise.end(), layer + rowStart);
+                }
+            }
+
+            // The height is only a scale on the cached sum
+            for (unsigned int x = 0; x < width; ++x)
+            {
+                float height_normalized = std::abs(siv::perlin_detail::RemapClamp_01(noise[x]));
+                heights[x] = height_normalized * maxHeight;
+            }
+        }
+    });
+
+    if (baseSums && std::find(keep.begin(), keep.end(), baseOctaves) == keep.end()) {
+        m_octaveLayers.erase(baseOctaves);
     }
-}
\ No newline at end of file
+}
+
+void PerlinNoiseGenerator::generateRegion(HeightField& heightField, unsigned int originX, unsigned int originZ,
+                                          unsigned int worldWidth, unsigned int worldDepth, int maxHeight)
+{
+    if (heightField.empty()) {
+        return;
+    }
+
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    const float spacing = heightField.getSpacing();
+    const int octaves = std::max(0, m_octaves);
+    const siv::PerlinNoise& perlin = m_perlin;
+
+    // Same noise inputs as generateTerrain on the whole world grid
+    float planeTotalWidth = (worldWidth > 1) ? (worldWidth - 1) * spacing : 1.0f;
+    float planeTotalDepth = (worldDepth > 1) ? (worldDepth - 1) * spacing : 1.0f;
+    if (planeTotalWidth == 0.0f) planeTotalWidth = 1.0f;
+    if (planeTotalDepth == 0.0f) planeTotalDepth = 1.0f;
+
+    std::vector<double> noiseX(width);
+    for (unsigned int x = 0; x < width; ++x)
+    {
+        float current_x_pos = (originX + x) * spacing;
+        float noiseInputX = (worldWidth == 1) ? 0.0f : current_x_pos / planeTotalWidth;
+        noiseX[x] = noiseInputX * m_frequency;
+    }
+
+    const unsigned int bands = (depth + kRowsPerTask - 1) / kRowsPerTask;
+    parallelFor(bands, m_threadCount, [&](std::size_t band) {
+        std::vector<double> noise(width);
+        const unsigned int firstRow = static_cast<unsigned int>(band) * kRowsPerTask;
+        const unsigned int lastRow = std::min(firstRow + kRowsPerTask, depth);
+        for (unsigned int z = firstRow; z < lastRow; ++z)
+        {
+            float* heights = heightField.row(z);
+            float current_z_pos = (originZ + z) * spacing;
+            float noiseInputZ = (worldDepth == 1) ? 0.0f : current_z_pos / planeTotalDepth;
+
+            std::fill(noise.begin(), noise.end(), 0.0);
+            addOctaves2DRow(perlin, noiseX.data(), noiseInputZ * m_frequency, static_cast<int>(width),
+                            0, octaves, 0.5, noise.data());
+            for (unsigned int x = 0; x < width; ++x)
+            {
+                float height_normalized = std::abs(siv::perlin_detail::RemapClamp_01(noise[x]));
+                heights[x] = height_normalized * maxHeight;
+            }
+        }
+    });
+}
@@ -0,0 +1,170 @@
+#include "PerlinRow.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+// Everything in noise3D that doesn't depend on x, for one row and octave.
+// z is fixed at SIVPERLIN_DEFAULT_Z, as noise2D does.
+struct OctaveTerms {
+    std::int32_t iy;
+    std::int32_t iz;
+    double v;
+    double w;
+    // Grad() of corner c with hash h is gradScale * (fx or fx - 1) + gradOffset,
+    // or just gradOffset when gradScale is 0 (the gradient ignores x)
+    double gradScale[8][16];
+    double gradOffset[8][16];
+};
+
+void octaveTerms(double y, OctaveTerms& terms)
+{
+    const double z = static_cast<double>(SIVPERLIN_DEFAULT_Z);
+    const double floorY = std::floor(y);
+    const double floorZ = std::floor(z);
+    const double fy = y - floorY;
+    const double fz = z - floorZ;
+    terms.iy = static_cast<std::int32_t>(floorY) & 255;
+    terms.iz = static_cast<std::int32_t>(floorZ) & 255;
+    terms.v = siv::perlin_detail::Fade(fy);
+    terms.w = siv::perlin_detail::Fade(fz);
+
+    // Corner c sits at (c & 1, (c >> 1) & 1, c >> 2), the same order noise3D uses for p0..p7
+    for (int corner = 0; corner < 8; ++corner) {
+        const double cy = (corner & 2) ? fy - 1 : fy;
+        const double cz = (corner & 4) ? fz - 1 : fz;
+        for (int h = 0; h < 16; ++h) {
+            // Multiplying by -1 is an exact negation, so these match Grad() bit for bit
+            const double signU = (h & 1) == 0 ? 1.0 : -1.0;
+            const double signV = (h & 2) == 0 ? 1.0 : -1.0;
+            double& scale = terms.gradScale[corner][h];
+            double& offset = terms.gradOffset[corner][h];
+            if (h < 8) {
+                scale = signU;
+                offset = signV * (h < 4 ? cy : cz);
+            } else if (h == 12 || h == 14) {
+                scale = signV;
+                offset = signU * cy;
+            } else {
+                scale = 0.0;
+                offset = signU * cy + signV * cz;
+            }
+        }
+    }
+}
+
+// std::floor without the libm call. Exact over the int32 range noise3D supports,
+// copysign keeps floor(-0.0) == -0.0
+inline double floorLane(double x)
+{
+    const double truncated = static_cast<double>(static_cast<std::int64_t>(x));
+    return std::copysign(truncated > x ? truncated - 1.0 : truncated, x);
+}
+
+// One octave of noise3D for a full packet, same operation order as BasicPerlinNoise::noise3D
+void noisePacket(const std::uint8_t* p, const double* x, const OctaveTerms& t, double* out)
+{
+    using siv::perlin_detail::Fade;
+    using siv::perlin_detail::Lerp;
+
+    // Hashing is a chain of table lookups, done per lane
+    double fx[kNoiseLanes];
+    double scale[8][kNoiseLanes];
+    double offset[8][kNoiseLanes];
+    for (int lane = 0; lane < kNoiseLanes; ++lane) {
+        const double floorX = floorLane(x[lane]);
+        const std::int32_t ix = static_cast<std::int32_t>(floorX) & 255;
+        fx[lane] = x[lane] - floorX;
+
+        const std::int32_t A = (p[ix] + t.iy) & 255;
+        const std::int32_t B = (p[(ix + 1) & 255] + t.iy) & 255;
+        const std::int32_t AA = (p[A] + t.iz) & 255;
+        const std::int32_t AB = (p[(A + 1) & 255] + t.iz) & 255;
+        const std::int32_t BA = (p[B] + t.iz) & 255;
+        const std::int32_t BB = (p[(B + 1) & 255] + t.iz) & 255;
+        const std::int32_t hashes[8] = {AA, BA, AB, BB, (AA + 1) & 255, (BA + 1) & 255, (AB + 1) & 255, (BB + 1) & 255};
+        for (int corner = 0; corner < 8; ++corner) {
+            const int h = p[hashes[corner]] & 15;
+            scale[corner][lane] = t.gradScale[corner][h];
+            offset[corner][lane] = t.gradOffset[corner][h];
+        }
+    }
+
+    // The rest is straight double math across the lanes
+    for (int lane = 0; lane < kNoiseLanes; ++lane) {
+        const double x0 = fx[lane];
+        const double x1 = fx[lane] - 1;
+        const double u = Fade(x0);
+        const auto grad = [&](int corner, double cx) {
+            const double s = scale[corner][lane];
+            const double o = offset[corner][lane];
+            const double g = s * cx + o;
+            return s == 0.0 ? o : g;
+        };
+        const double g[8] = {grad(0, x0), grad(1, x1), grad(2, x0), grad(3, x1),
+                             grad(4, x0), grad(5, x1), grad(6, x0), grad(7, x1)};
+
+        const double q0 = Lerp(g[0], g[1], u);
+        const double q1 = Lerp(g[2], g[3], u);
+        const double q2 = Lerp(g[4], g[5], u);
+        const double q3 = Lerp(g[6], g[7], u);
+
+        const double r0 = Lerp(q0, q1, t.v);
+        const double r1 = Lerp(q2, q3, t.v);
+
+        out[lane] = Lerp(r0, r1, t.w);
+    }
+}
+}
+
+void noise2DRow(const siv::PerlinNoise& perlin, const double* x, double y, int count, double* out)
+{
+    octave2DRow(perlin, x, y, count, 1, 0.5, out);
+}
+
+void octave2DRow(const siv::PerlinNoise& perlin, const double* x, double y, int count,
+                 int octaves, double persistence, double* out)
+{
+    std::fill(out, out + count, 0.0);
+    addOctaves2DRow(perlin, x, y, count, 0, octaves, persistence, out);
+}
+
+void addOctaves2DRow(const siv::PerlinNoise& perlin, const double* x, double y, int count,
+                     int firstOctave, int octaveCount, double persistence, double* out)
+{
+    const std::uint8_t* permutation = perlin.serialize().data();
+
+    // Octaves outside, so the y terms are worked out once per octave for the whole row.
+    // x * 2^octave is exact, the same value octave2D reaches by doubling.
+    double amplitude = 1;
+    double octaveY = y;
+    double scale = 1;
+    for (int octave = 0; octave < firstOctave; ++octave) {
+        octaveY *= 2;
+        scale *= 2;
+        amplitude *= persistence;
+    }
+
+    OctaveTerms terms;
+    for (int octave = 0; octave < octaveCount; ++octave) {
+        octaveTerms(octaveY, terms);
+        for (int first = 0; first < count; first += kNoiseLanes) {
+            const int lanes = std::min(kNoiseLanes, count - first);
+
+            // Short packets are padded, the padding lanes are computed and dropped
+            double packetX[kNoiseLanes];
+            double noise[kNoiseLanes];
+            for (int lane = 0; lane < kNoiseLanes; ++lane) {
+                packetX[lane] = lane < lanes ? x[first + lane] * scale : 0.0;
+            }
+            noisePacket(permutation, packetX, terms, noise);
+            for (int lane = 0; lane < lanes; ++lane) {
+                out[first + lane] += (noise[lane] * amplitude);
+            }
+        }
+        octaveY *= 2;
+        scale *= 2;
+        amplitude *= persistence;
+    }
+}
@@ -1,7 +1,7 @@
 /**
 * Manages terrain mesh generation and rendering
  * Handles the creation, modification, and rendering of a 3D terrain mesh.
- * Uses the Strategy pattern for terrain generation and delegates erosion to HydraulicErosion.
+ * Uses the Strategy pattern for terrain generation and erosion (TerrainGenerator and ErosionModel).
  */
 
 
@@ -16,17 +16,26 @@
 #include <ngl/VAOFactory.h>
 #include "PerlinNoise.hpp"
 #include <random>
+#include <utility>
 #include <ngl/Vec2.h>
 #include "PerlinNoiseGenerator.h"
+#include "PyramidErosion.h"
+#include "TerrainMesh.h"
 
 Plane::Plane(unsigned int _width, unsigned int _depth, float _spacing)
     : m_width(_width), m_depth(_depth), m_spacing(_spacing)
 {
-    // Initialize with default Perlin noise terrain generator
+    // Initialize with default Perlin noise terrain generator and droplet erosion
     m_terrainGenerator = std::make_shared<PerlinNoiseGenerator>(3.0f, 6, 90);
+    m_erosionModel = std::make_shared<HydraulicErosion>();
     generate();
 }
 
+Plane::~Plane()
+{
+    releaseIndexBuffer();
+}
+
 void Plane::clearTerrainData()
 {
     m_vertices.clear();
@@ -35,105 +44,200 @@ void Plane::clearTerrainData()
 
 void Plane::createBaseGridVertices()
 {
-    m_heightGrid.reserve(m_width * m_depth); // Reserve space for all unique vertices
+    // Heights are 0.0f for the base grid; noise will be applied later.
+    // x/z positions are implied by the grid index and spacing.
+    m_heightGrid.resize(m_width, m_depth, m_spacing);
+}
 
-    for (unsigned int z = 0; z < m_depth; ++z)
-    {
-        for (unsigned int x = 0; x < m_width; ++x)
-        {
-            float current_x_pos = x * m_spacing;
-            float current_z_pos = z * m_spacing;
-            // Y is 0.0f for the base grid; noise will be applied later.
-            m_heightGrid.emplace_back(current_x_pos, 0.0f, current_z_pos);
-        }
+
+
+void Plane::setErosionModel(std::shared_ptr<ErosionModel> model)
+{
+    if (!model) {
+        std::cerr << "Plane::setErosionModel() - No model given, keeping " << m_erosionModel->getName() << "." << std::endl;
+        return;
     }
+    m_erosionModel = std::move(model);
 }
 
+void Plane::setErosionThreading(unsigned int threads, int tileSize)
+{
+    ErosionParameters parameters = m_erosionModel->getParameters();
+    parameters.threads = threads;
+    m_erosionModel->setParameters(parameters);
+    HydraulicErosion* droplets = dropletModel();
+    if (droplets) {
+        droplets->setTileSize(tileSize);
+        markErosionModelChanged();
+    }
+}
 
+void Plane::setErosionPyramid(int levels)
+{
+    auto pyramid = std::dynamic_pointer_cast<PyramidErosion>(m_erosionModel);
+    if (levels <= 0) {
+        if (pyramid) m_erosionModel = pyramid->getSharedModel();
+    } else if (pyramid) {
+        pyramid->setLevels(levels);
+    } else {
+        m_erosionModel = std::make_shared<PyramidErosion>(m_erosionModel, levels);
+    }
+}
 
-void Plane::applyHydraulicErosion(int numDroplets, int dropletMaxLifetime) {
-    // Delegate to the erosion object
-    m_erosion.erode(m_heightGrid, m_width, m_depth, m_spacing, numDroplets, dropletMaxLifetime);
+HydraulicErosion* Plane::dropletModel()
+{
+    return dynamic_cast<HydraulicErosion*>(&PyramidErosion::fullResolutionModel(*m_erosionModel));
+}
 
-    // Update the mesh after erosion
-    refreshGPUAssets();
+const HydraulicErosion* Plane::dropletModel() const
+{
+    const ErosionModel& model = *m_erosionModel;
+    return dynamic_cast<const HydraulicErosion*>(&PyramidErosion::fullResolutionModel(model));
 }
 
+void Plane::markErosionModelChanged()
+{
+    auto* pyramid = dynamic_cast<PyramidErosion*>(m_erosionModel.get());
+    if (pyramid) pyramid->markModelChanged();
+}
 
+const TrailBuffer& Plane::getDropletTrailPoints() const
+{
+    const HydraulicErosion* droplets = dropletModel();
+    return droplets ? droplets->getDropletTrailPoints() : m_noTrailPoints;
+}
 
+void Plane::applyErosion(int iterations) {
+    // Delegate to the erosion model
+    m_erosionModel->clearDirtyTiles();
+    m_erosionModel->erode(m_heightGrid, iterations);
 
+    // Update the mesh after erosion, only where the model changed it
+    refreshGPUTiles(m_erosionModel->getDirtyTiles());
+}
 
-void Plane::buildTriangleMeshFromGrid(const std::vector<ngl::Vec3>& noisyGridVertices)
+void Plane::applyErosionSnapshot(HeightField& heightField,
+                                 const TrailBuffer& newTrailPoints,
+                                 std::uint64_t dropletCounter,
+                                 const DirtyTileMap& dirtyTiles)
 {
-    // Ensure m_vertices is clear before populating.
-    m_vertices.clear();
-
-    if (m_width < 2 || m_depth < 2) {
-        std::cerr << "Plane::buildTriangleMeshFromGrid() - Cannot build mesh with width or depth < 2. m_vertices will be empty." << std::endl;
+    if (heightField.getWidth() != m_heightGrid.getWidth() || heightField.getDepth() != m_heightGrid.getDepth()) {
+        std::cerr << "Plane::applyErosionSnapshot() - Snapshot size does not match the terrain, ignoring it." << std::endl;
         return;
     }
 
-    // Each grid cell becomes two triangles
-    // Reserve space: (width-1) * (depth-1) * 2 triangles * 3 vertices per triangle
-    m_vertices.reserve((m_width - 1) * (m_depth - 1) * 6);
+    std::swap(m_heightGrid, heightField);
+    HydraulicErosion* droplets = dropletModel();
+    if (droplets) {
+        droplets->appendDropletTrailPoints(newTrailPoints);
+        droplets->setDropletCounter(dropletCounter);
+    }
+
+    refreshGPUTiles(dirtyTiles);
+}
+
+
 
-    for (unsigned int z = 0; z < m_depth - 1; ++z)
+
+
+void Plane::buildTriangleMeshFromGrid(const HeightField& heightField)
+{
+    if (heightField.getWidth() < 2 || heightField.getDepth() < 2) {
+        std::cerr << "Plane::buildTriangleMeshFromGrid() - Cannot build mesh with width or depth < 2. m_indices will be empty." << std::endl;
+    }
+
+    // One shared vertex per grid node, the Height format uploads the height field itself
+    if (m_vertexFormat == TerrainVertexFormat::Position)
+    {
+        buildGridVertices(heightField, m_vertices);
+    }
+    else
     {
-        for (unsigned int x = 0; x < m_width - 1; ++x)
+        m_vertices.clear();
+    }
+
+    // The index buffer only depends on the grid size
+    if (m_lodEnabled)
+    {
+        if (m_lod.setGrid(heightField.getWidth(), heightField.getDepth(), heightField.getSpacing()))
         {
-            // Get the indices of the four vertices forming the current quad from the 1D noisyGridVertices vector, which is ordered row by row.
-            unsigned int topLeft = z * m_width + x;
-            unsigned int topRight = topLeft + 1;
-            unsigned int bottomLeft = (z + 1) * m_width + x;
-            unsigned int bottomRight = bottomLeft + 1;
-
-            // Triangle 1: topLeft, bottomLeft, topRight
-            m_vertices.push_back(noisyGridVertices[topLeft]);
-            m_vertices.push_back(noisyGridVertices[bottomLeft]);
-            m_vertices.push_back(noisyGridVertices[topRight]);
-
-            // Triangle 2: topRight, bottomLeft, bottomRight
-            m_vertices.push_back(noisyGridVertices[topRight]);
-            m_vertices.push_back(noisyGridVertices[bottomLeft]);
-            m_vertices.push_back(noisyGridVertices[bottomRight]);
+            m_layoutChanged = true;
         }
+        m_lod.updateBounds(heightField);
+    }
+    else if (heightField.getWidth() != m_indexWidth || heightField.getDepth() != m_indexDepth)
+    {
+        buildGridIndices(heightField.getWidth(), heightField.getDepth(), m_indices);
+        m_indexWidth = heightField.getWidth();
+        m_indexDepth = heightField.getDepth();
+        m_layoutChanged = true;
     }
 }
 
 void Plane::setupTerrainVAO()
 {
-    // Always reset the VAO if it exists to free old GPU resources before creating/re-populating.
-    if (m_vao)
+    const bool heightOnly = m_vertexFormat == TerrainVertexFormat::Height;
+    const std::size_t stride = heightOnly ? kHeightStreamStride : kPositionStreamStride;
+    const std::size_t vertexBytes = m_heightGrid.size() * stride;
+    const std::vector<std::uint32_t>& indices = activeIndices();
+    const GLfloat* vertexData = heightOnly ? m_heightGrid.data() : reinterpret_cast<const GLfloat*>(m_vertices.data());
+
+    // Same grid size: only the heights changed, refill the existing vertex buffer
+    if (m_vao && !m_layoutChanged)
     {
-        m_vao.reset();
+        if (!indices.empty())
+        {
+            m_vao->bind();
+            m_vao->setData(0, ngl::MultiBufferVAO::VertexData(vertexBytes, *vertexData, GL_DYNAMIC_DRAW));
+            m_vao->unbind();
+        }
+        return;
     }
 
-    if (m_vertices.empty())
+    // New grid size, free the old GPU resources before creating the new ones
+    m_vao.reset();
+    releaseIndexBuffer();
+    m_layoutChanged = false;
+
+    m_vao = ngl::vaoFactoryCast<ngl::MultiBufferVAO>(
+        ngl::VAOFactory::createVAO(ngl::multiBufferVAO, GL_TRIANGLES));
+
+    if (indices.empty())
     {
-        std::cerr << "Plane::setupTerrainVAO() - m_vertices is empty. Creating an empty VAO." << std::endl;
-        m_vao = ngl::vaoFactoryCast<ngl::MultiBufferVAO>(
-            ngl::VAOFactory::createVAO(ngl::multiBufferVAO, GL_TRIANGLES));
+        std::cerr << "Plane::setupTerrainVAO() - m_indices is empty. Creating an empty VAO." << std::endl;
         m_vao->bind();
         m_vao->setNumIndices(0); // Set to 0 indices if no data
         m_vao->unbind();
         return;
     }
 
-    m_vao = ngl::vaoFactoryCast<ngl::MultiBufferVAO>(
-        ngl::VAOFactory::createVAO(ngl::multiBufferVAO, GL_TRIANGLES));
-
     m_vao->bind();
 
-    m_vao->setData(ngl::MultiBufferVAO::VertexData(m_vertices.size() * sizeof(ngl::Vec3), m_vertices[0].m_x));
+    m_vao->setData(ngl::MultiBufferVAO::VertexData(vertexBytes, *vertexData, GL_DYNAMIC_DRAW));
 
-    m_vao->setVertexAttributePointer(0, 3, GL_FLOAT, 0, 0);
+    m_vao->setVertexAttributePointer(0, heightOnly ? 1 : 3, GL_FLOAT, 0, 0);
 
-    m_vao->setNumIndices(m_vertices.size());
+    // The element buffer binding is stored in the VAO, so render() only has to bind the VAO
+    glGenBuffers(1, &m_indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(std::uint32_t)),
+                 indices.data(), GL_STATIC_DRAW);
+
+    m_vao->setNumIndices(indices.size());
 
     m_vao->unbind();
 
 }
 
+void Plane::releaseIndexBuffer()
+{
+    if (m_indexBuffer != 0)
+    {
+        glDeleteBuffers(1, &m_indexBuffer);
+        m_indexBuffer = 0;
+    }
+}
+
 
 void Plane::generate()
 {
@@ -141,14 +245,15 @@ void Plane::generate()
     clearTerrainData();
 
     createBaseGridVertices();
-    m_erosion.clearDropletTrailPoints();
-    m_terrainGenerator->generateTerrain(m_heightGrid, m_width, m_depth, m_spacing, m_maxHeight);
+    // Fresh terrain restarts the model (droplet sequence, standing water) so regenerate + erode is reproducible
+    m_erosionModel->reset();
+    m_terrainGenerator->generateTerrain(m_heightGrid, m_maxHeight);
 
     buildTriangleMeshFromGrid(m_heightGrid);
 
     setupTerrainVAO();
 
-    std::cout << "Plane::generate() - completed. Final m_vertices size for VAO: " << m_vertices.size() << std::endl;
+    std::cout << "Plane::generate() - completed. Vertices: " << m_heightGrid.size() << ", indices: " << activeIndices().size() << std::endl;
 
 }
 
@@ -163,6 +268,99 @@ buildTriangleMeshFromGrid(m_heightGrid);
 setupTerrainVAO();
 }
 
+void Plane::refreshGPUTiles(const DirtyTileMap& dirtyTiles)
+{
+    const unsigned int width = m_heightGrid.getWidth();
+    const bool heightOnly = m_vertexFormat == TerrainVertexFormat::Height;
+    // A new grid size or a missing buffer needs the full rebuild
+    if (!m_vao || m_layoutChanged || activeIndices().empty() ||
+        (!heightOnly && m_vertices.size() != m_heightGrid.size()) ||
+        dirtyTiles.getWidth() != width || dirtyTiles.getDepth() != m_heightGrid.getDepth())
+    {
+        refreshGPUAssets();
+        return;
+    }
+    if (!dirtyTiles.any())
+    {
+        return;
+    }
+
+    if (m_lodEnabled)
+    {
+        m_lod.updateBounds(m_heightGrid, dirtyTiles.getBounds());
+    }
+
+    const std::size_t stride = heightOnly ? kHeightStreamStride : kPositionStreamStride;
+    glBindBuffer(GL_ARRAY_BUFFER, m_vao->getBufferID(0));
+    for (int tz = 0; tz < dirtyTiles.getTilesZ(); ++tz)
+    {
+        // One upload per row of tiles, from its first to its last dirty tile
+        int first = -1;
+        int last = -1;
+        for (int tx = 0; tx < dirtyTiles.getTilesX(); ++tx)
+        {
+            if (dirtyTiles.isDirty(tx, tz))
+            {
+                first = first < 0 ? tx : first;
+                last = tx;
+            }
+        }
+        if (first < 0)
+        {
+            continue;
+        }
+
+        const GridRect firstTile = dirtyTiles.tileRect(first, tz);
+        const GridRect rowRect{firstTile.minX, firstTile.minZ, dirtyTiles.tileRect(last, tz).maxX, firstTile.maxZ};
+        const GridUploadRange range = gridUploadRange(rowRect, width, stride);
+
+        const void* source = nullptr;
+        if (heightOnly)
+        {
+            source = m_heightGrid.data() + range.firstVertex;
+        }
+        else
+        {
+            // m_vertices always mirrors the GPU buffer, so the range may cover clean vertices too
+            for (int z = rowRect.minZ; z < rowRect.maxZ; ++z)
+            {
+                const float* heights = m_heightGrid.row(z);
+                ngl::Vec3* vertices = m_vertices.data() + static_cast<std::size_t>(z) * width;
+                for (int x = rowRect.minX; x < rowRect.maxX; ++x)
+                {
+                    vertices[x].m_y = heights[x];
+                }
+            }
+            source = &m_vertices[range.firstVertex].m_x;
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(range.byteOffset),
+                        static_cast<GLsizeiptr>(range.byteSize), source);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Plane::setLodEnabled(bool enabled)
+{
+    if (enabled == m_lodEnabled)
+    {
+        return;
+    }
+    m_lodEnabled = enabled;
+    m_layoutChanged = true;
+    refreshGPUAssets();
+}
+
+void Plane::setVertexFormat(TerrainVertexFormat format)
+{
+    if (format == m_vertexFormat)
+    {
+        return;
+    }
+    m_vertexFormat = format;
+    m_layoutChanged = true;
+    refreshGPUAssets();
+}
+
 void Plane::render() const
 {
     if (!m_vao || m_vao->numIndices() == 0) { // Add a check to prevent drawing an invalid/empty VAO
@@ -172,8 +370,32 @@ void Plane::render() const
 
     m_vao->bind();
     //gl->glEnable(GL_PROGRAM_POINT_SIZE);
-    m_vao->draw();
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_vao->numIndices()), GL_UNSIGNED_INT, nullptr);
     //gl->glDisable(GL_POLYGON_OFFSET_FILL);
     //gl->glDisable(GL_PROGRAM_POINT_SIZE);
     m_vao->unbind();
 }
+
+void Plane::renderLOD(const ngl::Vec3& eye, const ngl::Mat4& modelViewProjection)
+{
+    if (!m_lodEnabled)
+    {
+        render();
+        return;
+    }
+    if (!m_vao || m_vao->numIndices() == 0)
+    {
+        return;
+    }
+
+    m_lod.select(eye, modelViewProjection.m_openGL, m_lodDraws);
+
+    m_vao->bind();
+    for (const ChunkDraw& draw : m_lodDraws)
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(draw.indexCount), GL_UNSIGNED_INT,
+                                 reinterpret_cast<const void*>(draw.firstIndex * sizeof(std::uint32_t)),
+                                 static_cast<GLint>(draw.baseVertex));
+    }
+    m_vao->unbind();
+}
@@ -0,0 +1,227 @@
+#include "PyramidErosion.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "HydraulicErosion.h"
+#include "ParallelFor.h"
+
+PyramidErosion::PyramidErosion(std::shared_ptr<ErosionModel> model, int levels)
+    : m_model(std::move(model)), m_levels(std::clamp(levels, 0, kMaxLevels))
+{
+    if (!m_model) {
+        std::cerr << "PyramidErosion::PyramidErosion() - No model given, using droplets." << std::endl;
+        m_model = std::make_shared<HydraulicErosion>();
+    }
+}
+
+PyramidErosion::PyramidErosion(const PyramidErosion& other)
+    : m_model(other.m_model->clone()),
+      m_coarseModel(other.m_coarseModel ? other.m_coarseModel->clone() : nullptr),
+      m_modelChanged(other.m_modelChanged), m_levels(other.m_levels), m_refineFraction(other.m_refineFraction),
+      m_coarse(other.m_coarse), m_coarseStart(other.m_coarseStart), m_dirtyTiles(other.m_dirtyTiles)
+{
+}
+
+std::unique_ptr<ErosionModel> PyramidErosion::clone() const
+{
+    return std::make_unique<PyramidErosion>(*this);
+}
+
+void PyramidErosion::setParameters(const ErosionParameters& parameters)
+{
+    m_model->setParameters(parameters);
+    if (m_coarseModel) {
+        m_coarseModel->setParameters(parameters);
+    }
+}
+
+void PyramidErosion::reset()
+{
+    m_model->reset();
+    // The next erode copies the freshly reset model again
+    m_coarseModel.reset();
+}
+
+void PyramidErosion::settle(HeightField& heightField)
+{
+    settleCoarse(heightField);
+    m_model->settle(heightField);
+    m_dirtyTiles.resize(heightField.getWidth(), heightField.getDepth());
+    m_dirtyTiles.unite(m_model->getDirtyTiles());
+}
+
+void PyramidErosion::settleCoarse(HeightField& fine)
+{
+    if (!m_coarseModel) {
+        return;
+    }
+    const unsigned int factor = 1u << m_levels;
+    if (m_coarse.getWidth() == (fine.getWidth() + factor - 1) / factor &&
+        m_coarse.getDepth() == (fine.getDepth() + factor - 1) / factor) {
+        m_coarseStart = m_coarse;
+        m_coarseModel->settle(m_coarse);
+        addUpsampledChange(fine);
+        m_dirtyTiles.resize(fine.getWidth(), fine.getDepth());
+        m_dirtyTiles.markAll();
+    }
+    m_coarseModel.reset();
+}
+
+void PyramidErosion::clearDirtyTiles()
+{
+    m_dirtyTiles.clear();
+    m_model->clearDirtyTiles();
+}
+
+ErosionModel& PyramidErosion::fullResolutionModel(ErosionModel& model)
+{
+    auto* pyramid = dynamic_cast<PyramidErosion*>(&model);
+    return pyramid ? fullResolutionModel(pyramid->getModel()) : model;
+}
+
+const ErosionModel& PyramidErosion::fullResolutionModel(const ErosionModel& model)
+{
+    const auto* pyramid = dynamic_cast<const PyramidErosion*>(&model);
+    return pyramid ? fullResolutionModel(pyramid->getModel()) : model;
+}
+
+void PyramidErosion::erode(HeightField& heightField, int iterations)
+{
+    if (heightField.empty() || iterations <= 0) {
+        return;
+    }
+    const unsigned int factor = 1u << m_levels;
+    const unsigned int coarseWidth = (heightField.getWidth() + factor - 1) / factor;
+    const unsigned int coarseDepth = (heightField.getDepth() + factor - 1) / factor;
+    const int refineIterations = static_cast<int>(std::lround(iterations * m_refineFraction));
+    const int coarseIterationCount = m_model->coarseIterations(iterations - refineIterations, static_cast<int>(factor));
+
+    if (m_modelChanged) {
+        // The old copy was made with the old settings (or level count), its state goes onto the terrain
+        settleCoarse(heightField);
+        m_modelChanged = false;
+    }
+    if (m_levels > 0 && coarseWidth >= 2 && coarseDepth >= 2 && coarseIterationCount > 0) {
+        if (!m_coarseModel) {
+            m_coarseModel = m_model->clone();
+            m_coarseModel->reset();
+            // Nobody draws the coarse droplets
+            if (auto* droplets = dynamic_cast<HydraulicErosion*>(m_coarseModel.get())) {
+                droplets->setTrailRecording(false);
+            }
+        }
+        // Coarse droplets take the next counters of the full resolution sequence, and the refine
+        // pass and later runs go on after them, so no erode replays the same droplets
+        auto* droplets = dynamic_cast<HydraulicErosion*>(m_model.get());
+        auto* coarseDroplets = dynamic_cast<HydraulicErosion*>(m_coarseModel.get());
+        if (droplets && coarseDroplets) {
+            coarseDroplets->setDropletCounter(droplets->getDropletCounter());
+        }
+        downsample(heightField);
+        m_coarseStart = m_coarse;
+        m_coarseModel->erode(m_coarse, coarseIterationCount);
+        m_coarseModel->clearDirtyTiles();
+        if (droplets && coarseDroplets) {
+            droplets->setDropletCounter(coarseDroplets->getDropletCounter());
+        }
+        addUpsampledChange(heightField);
+
+        m_dirtyTiles.resize(heightField.getWidth(), heightField.getDepth());
+        m_dirtyTiles.markAll();
+        m_model->erode(heightField, refineIterations);
+        return;
+    }
+
+    // Grid too small for a coarse level, or too few iterations to share: the wrapped model alone
+    m_model->erode(heightField, iterations);
+    m_dirtyTiles.resize(heightField.getWidth(), heightField.getDepth());
+    m_dirtyTiles.unite(m_model->getDirtyTiles());
+}
+
+void PyramidErosion::downsample(const HeightField& fine)
+{
+    const unsigned int factor = 1u << m_levels;
+    const unsigned int width = fine.getWidth();
+    const unsigned int depth = fine.getDepth();
+    const unsigned int coarseWidth = (width + factor - 1) / factor;
+    const unsigned int coarseDepth = (depth + factor - 1) / factor;
+    if (m_coarse.getWidth() != coarseWidth || m_coarse.getDepth() != coarseDepth ||
+        m_coarse.getSpacing() != fine.getSpacing() * factor) {
+        m_coarse.resize(coarseWidth, coarseDepth, fine.getSpacing() * factor);
+    }
+
+    const unsigned int bands = (coarseDepth + kRowsPerTask - 1) / kRowsPerTask;
+    const unsigned int threads = m_model->getParameters().threads;
+    parallelFor(bands, threads, [&](std::size_t band) {
+        const unsigned int firstRow = static_cast<unsigned int>(band) * kRowsPerTask;
+        const unsigned int lastRow = std::min(firstRow + kRowsPerTask, coarseDepth);
+        for (unsigned int coarseZ = firstRow; coarseZ < lastRow; ++coarseZ) {
+            float* coarseRow = m_coarse.row(coarseZ);
+            std::fill(coarseRow, coarseRow + coarseWidth, 0.0f);
+            const unsigned int firstZ = coarseZ * factor;
+            const unsigned int lastZ = std::min(firstZ + factor, depth);
+            for (unsigned int z = firstZ; z < lastZ; ++z) {
+                const float* fineRow = fine.row(z);
+                for (unsigned int x = 0; x < width; ++x) {
+                    coarseRow[x / factor] += fineRow[x];
+                }
+            }
+            const float rows = static_cast<float>(lastZ - firstZ);
+            for (unsigned int coarseX = 0; coarseX < coarseWidth; ++coarseX) {
+                const unsigned int columns = std::min(factor, width - coarseX * factor);
+                coarseRow[coarseX] /= rows * static_cast<float>(columns);
+            }
+        }
+    });
+}
+
+void PyramidErosion::addUpsampledChange(HeightField& fine) const
+{
+    const unsigned int factor = 1u << m_levels;
+    const unsigned int width = fine.getWidth();
+    const unsigned int depth = fine.getDepth();
+    const unsigned int coarseWidth = m_coarse.getWidth();
+    const unsigned int coarseDepth = m_coarse.getDepth();
+
+    // Coarse nodes sit at the centre of their block, so fine node x maps to (x + 0.5) / factor - 0.5
+    const auto sample = [factor](unsigned int i, unsigned int count, unsigned int& first, unsigned int& second, float& t) {
+        const float position = std::clamp((static_cast<float>(i) + 0.5f) / static_cast<float>(factor) - 0.5f,
+                                          0.0f, static_cast<float>(count - 1));
+        first = static_cast<unsigned int>(position);
+        second = std::min(first + 1, count - 1);
+        t = position - static_cast<float>(first);
+    };
+
+    std::vector<unsigned int> firstColumn(width);
+    std::vector<unsigned int> secondColumn(width);
+    std::vector<float> columnWeight(width);
+    for (unsigned int x = 0; x < width; ++x) {
+        sample(x, coarseWidth, firstColumn[x], secondColumn[x], columnWeight[x]);
+    }
+
+    const unsigned int bands = (depth + kRowsPerTask - 1) / kRowsPerTask;
+    const unsigned int threads = m_model->getParameters().threads;
+    parallelFor(bands, threads, [&](std::size_t band) {
+        const unsigned int firstRow = static_cast<unsigned int>(band) * kRowsPerTask;
+        const unsigned int lastRow = std::min(firstRow + kRowsPerTask, depth);
+        for (unsigned int z = firstRow; z < lastRow; ++z) {
+            unsigned int firstZ = 0;
+            unsigned int secondZ = 0;
+            float rowWeight = 0.0f;
+            sample(z, coarseDepth, firstZ, secondZ, rowWeight);
+            const float* after0 = m_coarse.row(firstZ);
+            const float* after1 = m_coarse.row(secondZ);
+            const float* before0 = m_coarseStart.row(firstZ);
+            const float* before1 = m_coarseStart.row(secondZ);
+            float* fineRow = fine.row(z);
+            for (unsigned int x = 0; x < width; ++x) {
+                const unsigned int a = firstColumn[x];
+                const unsigned int b = secondColumn[x];
+                const float t = columnWeight[x];
+                const float change0 = (after0[a] - before0[a]) * (1.0f - t) + (after0[b] - before0[b]) * t;
+                const float change1 = (after1[a] - before1[a]) * (1.0f - t) + (after1[b] - before1[b]) * t;
+                fineRow[x] += change0 * (1.0f - rowWeight) + change1 * rowWeight;
+            }
+        }
+    });
+}
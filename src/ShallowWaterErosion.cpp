@@ -0,0 +1,289 @@
+#include "ShallowWaterErosion.h"
+#include <algorithm>
+#include <cmath>
+#include "ParallelFor.h"
+#include "RowStencil.h"
+
+namespace
+{
+// Below this depth a cell counts as dry, its velocity would be flux divided by ~0
+constexpr float kMinWaterDepth = 1e-4f;
+}
+
+template <typename Pass>
+void ShallowWaterErosion::forRowBands(unsigned int depth, Pass&& pass) const
+{
+    const unsigned int bands = (depth + kRowsPerTask - 1) / kRowsPerTask;
+    parallelFor(bands, m_threadCount, [&](std::size_t band) {
+        const unsigned int firstRow = static_cast<unsigned int>(band) * kRowsPerTask;
+        pass(firstRow, std::min(firstRow + kRowsPerTask, depth));
+    });
+}
+
+void ShallowWaterErosion::reset()
+{
+    for (std::vector<float>* field : {&m_water, &m_sediment, &m_sedimentNext, &m_fluxLeft, &m_fluxRight,
+                                      &m_fluxUp, &m_fluxDown, &m_velocityX, &m_velocityZ, &m_capacity, &m_waterStart}) {
+        std::fill(field->begin(), field->end(), 0.0f);
+    }
+}
+
+void ShallowWaterErosion::settle(HeightField& heightField)
+{
+    if (heightField.getWidth() == m_width && heightField.getDepth() == m_depth && !m_sediment.empty()) {
+        float* b = heightField.data();
+        for (std::size_t i = 0; i < m_sediment.size(); ++i) {
+            b[i] += m_sediment[i];
+        }
+        m_dirtyTiles.resize(m_width, m_depth);
+        m_dirtyTiles.markAll();
+    }
+    reset();
+}
+
+std::unique_ptr<ErosionModel> ShallowWaterErosion::clone() const
+{
+    return std::make_unique<ShallowWaterErosion>(*this);
+}
+
+void ShallowWaterErosion::setParameters(const ErosionParameters& parameters)
+{
+    m_dissolvingRate = parameters.erosionRate;
+    m_depositionRate = parameters.depositionRate;
+    m_evaporationRate = parameters.evaporationRate;
+    m_threadCount = parameters.threads;
+}
+
+ErosionParameters ShallowWaterErosion::getParameters() const
+{
+    ErosionParameters parameters;
+    parameters.erosionRate = m_dissolvingRate;
+    parameters.depositionRate = m_depositionRate;
+    parameters.evaporationRate = m_evaporationRate;
+    parameters.threads = m_threadCount;
+    return parameters;
+}
+
+void ShallowWaterErosion::resize(unsigned int width, unsigned int depth)
+{
+    if (width == m_width && depth == m_depth) {
+        return;
+    }
+    m_width = width;
+    m_depth = depth;
+    const std::size_t cells = static_cast<std::size_t>(width) * depth;
+    for (std::vector<float>* field : {&m_water, &m_sediment, &m_sedimentNext, &m_fluxLeft, &m_fluxRight,
+                                      &m_fluxUp, &m_fluxDown, &m_velocityX, &m_velocityZ, &m_capacity, &m_waterStart}) {
+        field->assign(cells, 0.0f);
+    }
+}
+
+void ShallowWaterErosion::erode(HeightField& heightField, int steps)
+{
+    if (heightField.getWidth() < 2 || heightField.getDepth() < 2 || steps <= 0) {
+        return;
+    }
+    resize(heightField.getWidth(), heightField.getDepth());
+    m_dirtyTiles.resize(heightField.getWidth(), heightField.getDepth());
+
+    for (int i = 0; i < steps; ++i) {
+        simulateStep(heightField);
+    }
+    // Every cell can change in every step
+    m_dirtyTiles.markAll();
+}
+
+void ShallowWaterErosion::simulateStep(HeightField& heightField)
+{
+    const unsigned int depth = heightField.getDepth();
+    // Each pass finishes on every row before the next starts, passes only write their own cells
+    forRowBands(depth, [&](unsigned int first, unsigned int last) { updateFlux(heightField, first, last); });
+    forRowBands(depth, [&](unsigned int first, unsigned int last) { updateWaterAndVelocity(heightField, first, last); });
+    forRowBands(depth, [&](unsigned int first, unsigned int last) { erodeAndDeposit(heightField, first, last); });
+    forRowBands(depth, [&](unsigned int first, unsigned int last) { transportSediment(heightField, first, last); });
+    std::swap(m_sediment, m_sedimentNext);
+}
+
+void ShallowWaterErosion::updateFlux(const HeightField& heightField, unsigned int firstRow, unsigned int lastRow)
+{
+    const unsigned int width = m_width;
+    const float length = heightField.getSpacing();
+    const float timeStep = m_timeStep;
+    const float fluxFactor = timeStep * m_pipeArea * m_gravity / length;
+    const float rain = m_timeStep * m_rainRate;
+    const float* b = heightField.data();
+    const float* d = m_water.data();
+    // Locals rather than members so the stores below cannot alias them and the interior vectorises
+    float* fluxLeft = m_fluxLeft.data();
+    float* fluxRight = m_fluxRight.data();
+    float* fluxUp = m_fluxUp.data();
+    float* fluxDown = m_fluxDown.data();
+    float* waterStart = m_waterStart.data();
+
+    for (unsigned int z = firstRow; z < lastRow; ++z) {
+        // The border rows compare against themselves, which gives no flow and keeps the loads unconditional
+        const std::size_t up = z > 0 ? width : 0;
+        const std::size_t down = z + 1 < m_depth ? width : 0;
+        const std::size_t row = static_cast<std::size_t>(z) * width;
+        forRowCells(width, [&](std::size_t x, bool hasLeft, bool hasRight) {
+            const std::size_t i = row + x;
+            // Rain falls evenly, so it only changes this cell's volume, not the height differences
+            const float water = d[i] + rain;
+            const float surface = b[i] + d[i];
+
+            // No pipes leave the grid
+            const float left = hasLeft ? std::max(0.0f, fluxLeft[i] + fluxFactor * (surface - b[i - 1] - d[i - 1])) : 0.0f;
+            const float right = hasRight ? std::max(0.0f, fluxRight[i] + fluxFactor * (surface - b[i + 1] - d[i + 1])) : 0.0f;
+            const float upFlux = std::max(0.0f, fluxUp[i] + fluxFactor * (surface - b[i - up] - d[i - up]));
+            const float downFlux = std::max(0.0f, fluxDown[i] + fluxFactor * (surface - b[i + down] - d[i + down]));
+
+            // Never let more water out in a step than the cell holds
+            const float outflow = (left + right + upFlux + downFlux) * timeStep;
+            const float scale = outflow > 0.0f ? std::min(1.0f, water * length * length / outflow) : 1.0f;
+            waterStart[i] = water;
+            fluxLeft[i] = left * scale;
+            fluxRight[i] = right * scale;
+            fluxUp[i] = upFlux * scale;
+            fluxDown[i] = downFlux * scale;
+        });
+    }
+}
+
+void ShallowWaterErosion::updateWaterAndVelocity(const HeightField& heightField, unsigned int firstRow, unsigned int lastRow)
+{
+    const unsigned int width = m_width;
+    const float length = heightField.getSpacing();
+    const float volumeFactor = m_timeStep / (length * length);
+    const float maxSpeed = length / m_timeStep;
+    const float minTilt = m_minTilt;
+    const float maxErosionDepth = m_maxErosionDepth;
+    const float sedimentCapacity = m_sedimentCapacity;
+    const float* b = heightField.data();
+    // Locals rather than members so the stores below cannot alias them and the interior vectorises
+    const float* fluxLeft = m_fluxLeft.data();
+    const float* fluxRight = m_fluxRight.data();
+    const float* fluxUp = m_fluxUp.data();
+    const float* fluxDown = m_fluxDown.data();
+    const float* waterStart = m_waterStart.data();
+    float* water = m_water.data();
+    float* velocityX = m_velocityX.data();
+    float* velocityZ = m_velocityZ.data();
+    float* capacity = m_capacity.data();
+
+    for (unsigned int z = firstRow; z < lastRow; ++z) {
+        const bool hasUp = z > 0;
+        const bool hasDown = z + 1 < m_depth;
+        // Border rows read their own row and weigh it out, so the loads stay unconditional
+        const std::size_t up = hasUp ? width : 0;
+        const std::size_t down = hasDown ? width : 0;
+        const float upWeight = hasUp ? 1.0f : 0.0f;
+        const float downWeight = hasDown ? 1.0f : 0.0f;
+        // One sided slopes on the border rows and columns
+        const std::size_t rowUp = hasUp ? z - 1 : z;
+        const std::size_t rowDown = hasDown ? z + 1 : z;
+        const float slopeZScale = 1.0f / (static_cast<float>(rowDown - rowUp) * length);
+        const std::size_t row = static_cast<std::size_t>(z) * width;
+        forRowCells(width, [&](std::size_t x, bool hasLeft, bool hasRight) {
+            const std::size_t i = row + x;
+            // What the neighbours push into this cell
+            const float fromLeft = hasLeft ? fluxRight[i - 1] : 0.0f;
+            const float fromRight = hasRight ? fluxLeft[i + 1] : 0.0f;
+            const float fromUp = fluxDown[i - up] * upWeight;
+            const float fromDown = fluxUp[i + down] * downWeight;
+
+            const float inflow = fromLeft + fromRight + fromUp + fromDown;
+            const float outflow = fluxLeft[i] + fluxRight[i] + fluxUp[i] + fluxDown[i];
+            const float before = waterStart[i];
+            const float after = std::max(0.0f, before + volumeFactor * (inflow - outflow));
+            water[i] = after;
+
+            // Velocity from the water passing through the cell, over the average depth
+            const float meanDepth = 0.5f * (before + after);
+            const float passX = 0.5f * (fromLeft - fluxLeft[i] + fluxRight[i] - fromRight);
+            const float passZ = 0.5f * (fromUp - fluxUp[i] + fluxDown[i] - fromDown);
+            const float inverseDepth = meanDepth > kMinWaterDepth ? 1.0f / (meanDepth * length) : 0.0f;
+            const float cellVelocityX = passX * inverseDepth;
+            const float cellVelocityZ = passZ * inverseDepth;
+            velocityX[i] = cellVelocityX;
+            velocityZ[i] = cellVelocityZ;
+
+            // Transport capacity from the local slope and speed, read before any height changes
+            const std::size_t columnLeft = hasLeft ? x - 1 : x;
+            const std::size_t columnRight = hasRight ? x + 1 : x;
+            const float slopeX = (b[row + columnRight] - b[row + columnLeft]) /
+                                 (static_cast<float>(columnRight - columnLeft) * length);
+            const float slopeZ = (b[rowDown * width + x] - b[rowUp * width + x]) * slopeZScale;
+            const float slopeSquared = slopeX * slopeX + slopeZ * slopeZ;
+            const float sinTilt = std::max(minTilt, std::sqrt(slopeSquared / (1.0f + slopeSquared)));
+            // Thin films carry little, otherwise a drop of water on a slope could dissolve a cliff
+            const float depthFactor = std::min(1.0f, meanDepth / maxErosionDepth);
+            const float speed = std::min(std::sqrt(cellVelocityX * cellVelocityX + cellVelocityZ * cellVelocityZ), maxSpeed);
+            capacity[i] = sedimentCapacity * sinTilt * speed * depthFactor;
+        });
+    }
+}
+
+void ShallowWaterErosion::erodeAndDeposit(HeightField& heightField, unsigned int firstRow, unsigned int lastRow)
+{
+    float* b = heightField.data();
+    const float* capacity = m_capacity.data();
+    float* sediment = m_sediment.data();
+    const float dissolvingRate = m_dissolvingRate;
+    const float depositionRate = m_depositionRate;
+    const std::size_t first = static_cast<std::size_t>(firstRow) * m_width;
+    const std::size_t last = static_cast<std::size_t>(lastRow) * m_width;
+
+    // Only this cell is touched, so this is a straight loop over the band
+    for (std::size_t i = first; i < last; ++i) {
+        const float difference = capacity[i] - sediment[i];
+        const float rate = difference > 0.0f ? dissolvingRate : depositionRate;
+        // Height 0 is bedrock, a cell can't give up more material than it has above it
+        const float amount = std::min(rate * difference, std::max(b[i], 0.0f));
+        b[i] -= amount;
+        sediment[i] += amount;
+    }
+}
+
+void ShallowWaterErosion::transportSediment(const HeightField& heightField, unsigned int firstRow, unsigned int lastRow)
+{
+    const unsigned int width = m_width;
+    const float volumeFactor = m_timeStep / (heightField.getSpacing() * heightField.getSpacing());
+    const float evaporation = std::max(0.0f, 1.0f - m_evaporationRate * m_timeStep);
+    const float* s = m_sediment.data();
+    // Locals rather than members so the stores below cannot alias them and the interior vectorises
+    const float* fluxLeft = m_fluxLeft.data();
+    const float* fluxRight = m_fluxRight.data();
+    const float* fluxUp = m_fluxUp.data();
+    const float* fluxDown = m_fluxDown.data();
+    const float* waterStart = m_waterStart.data();
+    float* water = m_water.data();
+    float* sedimentNext = m_sedimentNext.data();
+
+    // Share of a cell's water (and so of its suspended sediment) that left through one pipe this step
+    const auto share = [&](float flux, std::size_t cell) {
+        const float water = waterStart[cell];
+        return water > 0.0f ? flux * volumeFactor / water : 0.0f;
+    };
+
+    for (unsigned int z = firstRow; z < lastRow; ++z) {
+        const std::size_t up = z > 0 ? width : 0;
+        const std::size_t down = z + 1 < m_depth ? width : 0;
+        const float upWeight = z > 0 ? 1.0f : 0.0f;
+        const float downWeight = z + 1 < m_depth ? 1.0f : 0.0f;
+        const std::size_t row = static_cast<std::size_t>(z) * width;
+        forRowCells(width, [&](std::size_t x, bool hasLeft, bool hasRight) {
+            const std::size_t i = row + x;
+            // Sediment moves with the water through the same pipes, so it is conserved.
+            // Gathering from the neighbours keeps the pass writing only its own cell.
+            const float outflow = fluxLeft[i] + fluxRight[i] + fluxUp[i] + fluxDown[i];
+            float moved = s[i] * (1.0f - share(outflow, i));
+            moved += hasLeft ? s[i - 1] * share(fluxRight[i - 1], i - 1) : 0.0f;
+            moved += hasRight ? s[i + 1] * share(fluxLeft[i + 1], i + 1) : 0.0f;
+            moved += s[i - up] * share(fluxDown[i - up], i - up) * upWeight;
+            moved += s[i + down] * share(fluxUp[i + down], i + down) * downWeight;
+            sedimentNext[i] = moved;
+
+            water[i] *= evaporation;
+        });
+    }
+}
@@ -0,0 +1,271 @@
+/**
+ * Headless terrain baker.
+ * Runs the same generate -> erode path as Plane without a window or GL context and writes
+ * the resulting heightmap to disk, for batch bakes on machines without a display.
+ *
+ * Usage: TerrainBake [--size N] [--seed S] [--noise-seed S] [--octaves N] [--frequency F] [--height H]
+ *                    [--model droplet|pipe|thermal] [--droplets N] [--lifetime N] [--steps N]
+ *                    [--talus N] [--talus-slope F] [--pyramid N]
+ *                    [--threads N] [--tile N] [--batched 0|1] [--output file.pgm|file.r32]
+ *                    [--tiles DIR] [--tile-file N] [--tile-cache N] [--halo N]
+ *
+ * With --tiles the terrain lives in memory mapped tile files in DIR instead of one grid, so it can be
+ * larger than memory; generation and erosion stream over the tiles (see TiledTerrain.h).
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "ErosionModel.h"
+#include "HeightField.h"
+#include "HeightFieldIO.h"
+#include "HydraulicErosion.h"
+#include "PerlinNoiseGenerator.h"
+#include "PyramidErosion.h"
+#include "ShallowWaterErosion.h"
+#include "ThermalErosion.h"
+#include "TiledHeightField.h"
+#include "TiledTerrain.h"
+
+namespace
+{
+struct BakeSettings {
+    unsigned int size = 300;
+    float spacing = 1.0f;
+    std::uint64_t seed = 0x5EED;
+    std::uint32_t noiseSeed = PerlinNoiseGenerator::kDefaultSeed;
+    int octaves = 6;
+    float frequency = 3.0f;
+    int maxHeight = 90;
+    std::string model = "droplet";
+    int droplets = 40000;
+    int lifetime = 30;
+    int steps = 2000;
+    int talusIterations = 0;
+    float talusSlope = 2.0f;
+    int pyramidLevels = 0;
+    unsigned int threads = 0;
+    int tileSize = 64;
+    bool batched = true;
+    std::string output = "terrain.pgm";
+    std::string tileDirectory;
+    unsigned int tileFileSize = TiledHeightField::kDefaultTileSize;
+    std::size_t tileCache = TiledHeightField::kDefaultCacheTiles;
+    unsigned int halo = kDefaultTileHalo;
+};
+
+void printUsage()
+{
+    std::cout << "Usage: TerrainBake [options]\n"
+              << "  --size N        grid width and depth in vertices (default 300)\n"
+              << "  --spacing F     distance between vertices (default 1.0)\n"
+              << "  --seed S        droplet seed (default 24301)\n"
+              << "  --noise-seed S  terrain noise seed (default 123456)\n"
+              << "  --octaves N     noise octaves (default 6)\n"
+              << "  --frequency F   noise frequency (default 3.0)\n"
+              << "  --height H      maximum terrain height (default 90)\n"
+              << "  --model M       erosion model, droplet, pipe or thermal (default droplet)\n"
+              << "  --droplets N    erosion droplets (default 40000)\n"
+              << "  --lifetime N    maximum droplet steps (default 30)\n"
+              << "  --steps N       pipe time steps or thermal sweeps (default 2000)\n"
+              << "  --talus N       talus sweeps per 1000 droplets (default 0)\n"
+              << "  --talus-slope F steepest stable slope for the talus sweeps and thermal model (default 2.0)\n"
+              << "  --pyramid N     run most iterations on a grid halved N times first, 0 = off (default 0)\n"
+              << "  --threads N     generation and erosion threads, 0 = all cores (default 0)\n"
+              << "  --tile N        erosion tile size, 0 = serial (default 64)\n"
+              << "  --batched 0|1   SIMD droplet packets (default 1)\n"
+              << "  --output FILE   .pgm for a 16 bit image, otherwise raw float32 (default terrain.pgm)\n"
+              << "  --tiles DIR     keep the terrain in memory mapped tile files in DIR, for terrains larger than memory\n"
+              << "  --tile-file N   nodes along a tile file's side (default 1024)\n"
+              << "  --tile-cache N  tile files mapped at once (default 64)\n"
+              << "  --halo N        nodes of the neighbouring tiles eroded with each tile (default 64)\n";
+}
+
+enum class ParseResult { Bake, Help, Invalid };
+
+// Returns Invalid (after printing why) when the arguments can't be used, Help after printing the usage
+ParseResult parseArguments(int argc, char* argv[], BakeSettings& settings)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage();
+            return ParseResult::Help;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "TerrainBake - Missing value for " << option << std::endl;
+            return ParseResult::Invalid;
+        }
+        const std::string value = argv[++i];
+
+        try {
+            if (option == "--size") { settings.size = static_cast<unsigned int>(std::stoul(value)); }
+            else if (option == "--spacing") { settings.spacing = std::stof(value); }
+            else if (option == "--seed") { settings.seed = std::stoull(value); }
+            else if (option == "--noise-seed") { settings.noiseSeed = static_cast<std::uint32_t>(std::stoul(value)); }
+            else if (option == "--octaves") { settings.octaves = std::stoi(value); }
+            else if (option == "--frequency") { settings.frequency = std::stof(value); }
+            else if (option == "--height") { settings.maxHeight = std::stoi(value); }
+            else if (option == "--model") { settings.model = value; }
+            else if (option == "--droplets") { settings.droplets = std::stoi(value); }
+            else if (option == "--lifetime") { settings.lifetime = std::stoi(value); }
+            else if (option == "--steps") { settings.steps = std::stoi(value); }
+            else if (option == "--talus") { settings.talusIterations = std::stoi(value); }
+            else if (option == "--talus-slope") { settings.talusSlope = std::stof(value); }
+            else if (option == "--pyramid") { settings.pyramidLevels = std::stoi(value); }
+            else if (option == "--threads") { settings.threads = static_cast<unsigned int>(std::stoul(value)); }
+            else if (option == "--tile") { settings.tileSize = std::stoi(value); }
+            else if (option == "--batched") { settings.batched = std::stoi(value) != 0; }
+            else if (option == "--output") { settings.output = value; }
+            else if (option == "--tiles") { settings.tileDirectory = value; }
+            else if (option == "--tile-file") { settings.tileFileSize = static_cast<unsigned int>(std::stoul(value)); }
+            else if (option == "--tile-cache") { settings.tileCache = std::stoul(value); }
+            else if (option == "--halo") { settings.halo = static_cast<unsigned int>(std::stoul(value)); }
+            else {
+                std::cerr << "TerrainBake - Unknown option " << option << std::endl;
+                printUsage();
+                return ParseResult::Invalid;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "TerrainBake - Invalid value '" << value << "' for " << option << std::endl;
+            return ParseResult::Invalid;
+        }
+    }
+
+    if (settings.size < 2 || settings.spacing <= 0.0f) {
+        std::cerr << "TerrainBake - Size must be at least 2 and spacing positive." << std::endl;
+        return ParseResult::Invalid;
+    }
+    if (settings.model != "droplet" && settings.model != "pipe" && settings.model != "thermal") {
+        std::cerr << "TerrainBake - Unknown model " << settings.model << ", use droplet, pipe or thermal." << std::endl;
+        return ParseResult::Invalid;
+    }
+    return ParseResult::Bake;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The configured erosion model, iterations receives the droplets or steps to run
+std::unique_ptr<ErosionModel> makeErosionModel(const BakeSettings& settings, int& iterations)
+{
+    std::unique_ptr<ErosionModel> erosion;
+    if (settings.model == "pipe") {
+        erosion = std::make_unique<ShallowWaterErosion>();
+        iterations = settings.steps;
+    } else if (settings.model == "thermal") {
+        auto thermal = std::make_unique<ThermalErosion>();
+        thermal->setTalusSlope(settings.talusSlope);
+        erosion = std::move(thermal);
+        iterations = settings.steps;
+    } else {
+        auto droplets = std::make_unique<HydraulicErosion>();
+        droplets->setSeed(settings.seed);
+        droplets->setTileSize(settings.tileSize);
+        droplets->setBatchedSimulation(settings.batched);
+        droplets->setDropletLifetime(settings.lifetime);
+        droplets->setTalusIterations(settings.talusIterations);
+        droplets->getTalusPass().setTalusSlope(settings.talusSlope);
+        // Nothing looks at the trails in a bake
+        droplets->setTrailRecording(false);
+        erosion = std::move(droplets);
+        iterations = settings.droplets;
+    }
+    if (settings.pyramidLevels > 0) {
+        erosion = std::make_unique<PyramidErosion>(std::move(erosion), settings.pyramidLevels);
+    }
+    ErosionParameters parameters = erosion->getParameters();
+    parameters.threads = settings.threads;
+    erosion->setParameters(parameters);
+    return erosion;
+}
+
+// Rewrites one progress line per tile
+TileProgress printTileProgress(const char* stage)
+{
+    return [stage](std::size_t tilesDone, std::size_t tileCount) {
+        std::cout << "\r" << stage << " tile " << tilesDone << " / " << tileCount << std::flush;
+        if (tilesDone == tileCount) {
+            std::cout << std::endl;
+        }
+    };
+}
+
+// Out of core bake, the terrain only ever exists as tile files
+int bakeTiled(const BakeSettings& settings, PerlinNoiseGenerator& generator)
+{
+    TiledHeightField field;
+    if (!field.create(settings.tileDirectory, settings.size, settings.size, settings.spacing, settings.tileFileSize)) {
+        return 1;
+    }
+    field.setCacheCapacity(settings.tileCache);
+
+    auto start = std::chrono::steady_clock::now();
+    if (!generateTiled(generator, field, settings.maxHeight, printTileProgress("Generating"))) {
+        return 1;
+    }
+    std::cout << "Generated " << settings.size << "x" << settings.size << " terrain in " << field.getTilesX() * field.getTilesZ()
+              << " tiles in " << millisecondsSince(start) << " ms" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    int iterations = 0;
+    std::unique_ptr<ErosionModel> erosion = makeErosionModel(settings, iterations);
+    if (!erodeTiled(*erosion, field, iterations, settings.halo, printTileProgress("Eroding"))) {
+        return 1;
+    }
+    std::cout << "Eroded " << iterations << " " << erosion->getName() << " iterations in "
+              << millisecondsSince(start) << " ms" << std::endl;
+
+    if (!writeHeightField(field, settings.output) || !field.flush()) {
+        return 1;
+    }
+    std::cout << "Wrote " << settings.output << " and the tiles in " << settings.tileDirectory << std::endl;
+    return 0;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    BakeSettings settings;
+    const ParseResult parsed = parseArguments(argc, argv, settings);
+    if (parsed != ParseResult::Bake) {
+        return parsed == ParseResult::Help ? 0 : 1;
+    }
+
+    PerlinNoiseGenerator generator(settings.frequency, settings.octaves, settings.maxHeight, settings.noiseSeed);
+    generator.setThreadCount(settings.threads);
+    // One generate per bake, keeping octave sums around would only cost memory
+    generator.setOctaveCacheBudget(0);
+    if (!settings.tileDirectory.empty()) {
+        return bakeTiled(settings, generator);
+    }
+
+    // Same data path as Plane::generate followed by Plane::applyErosion
+    HeightField heightField(settings.size, settings.size, settings.spacing);
+
+    auto start = std::chrono::steady_clock::now();
+    generator.generateTerrain(heightField, settings.maxHeight);
+    std::cout << "Generated " << settings.size << "x" << settings.size << " terrain in "
+              << millisecondsSince(start) << " ms" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    int iterations = 0;
+    std::unique_ptr<ErosionModel> erosion = makeErosionModel(settings, iterations);
+    erosion->erode(heightField, iterations);
+    // The bake ends here, like a GUI run: sediment still in the water goes back onto the terrain
+    erosion->settle(heightField);
+    std::cout << "Eroded " << iterations << " " << erosion->getName() << " iterations in "
+              << millisecondsSince(start) << " ms" << std::endl;
+
+    if (!writeHeightField(heightField, settings.output)) {
+        return 1;
+    }
+    std::cout << "Wrote " << settings.output << std::endl;
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "TerrainLOD.h"
+#include <algorithm>
+#include <cmath>
+
+Frustum Frustum::fromMatrix(const float* m)
+{
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others.
+    // Column major storage, so row r is m[r], m[4 + r], m[8 + r], m[12 + r].
+    auto row = [m](int r, int c) { return m[c * 4 + r]; };
+    Frustum frustum;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            frustum.planes[i * 2][c] = row(3, c) + row(i, c);
+            frustum.planes[i * 2 + 1][c] = row(3, c) - row(i, c);
+        }
+    }
+    return frustum;
+}
+
+bool Frustum::intersectsBox(const ngl::Vec3& boxMin, const ngl::Vec3& boxMax) const
+{
+    for (const auto& plane : planes)
+    {
+        // Corner furthest along the plane normal, if that is outside the whole box is
+        const float x = plane[0] >= 0.0f ? boxMax.m_x : boxMin.m_x;
+        const float y = plane[1] >= 0.0f ? boxMax.m_y : boxMin.m_y;
+        const float z = plane[2] >= 0.0f ? boxMax.m_z : boxMin.m_z;
+        if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TerrainLOD::setGrid(unsigned int width, unsigned int depth, float spacing)
+{
+    m_spacing = spacing;
+    if (width == m_width && depth == m_depth && !m_chunks.empty()) {
+        return false;
+    }
+    m_width = width;
+    m_depth = depth;
+    m_chunks.clear();
+    m_indices.clear();
+    m_lists.clear();
+    m_chunksX = 0;
+    m_chunksZ = 0;
+    if (width < 2 || depth < 2) {
+        return true;
+    }
+
+    const int quadsX = static_cast<int>(width) - 1;
+    const int quadsZ = static_cast<int>(depth) - 1;
+    m_chunksX = (quadsX + kChunkQuads - 1) / kChunkQuads;
+    m_chunksZ = (quadsZ + kChunkQuads - 1) / kChunkQuads;
+
+    // Chunks along the far edges may be cut short, every size shares one set of lists
+    m_chunks.resize(static_cast<std::size_t>(m_chunksX) * m_chunksZ);
+    for (int cz = 0; cz < m_chunksZ; ++cz)
+    {
+        for (int cx = 0; cx < m_chunksX; ++cx)
+        {
+            Chunk& chunk = m_chunks[cz * m_chunksX + cx];
+            chunk.x0 = cx * kChunkQuads;
+            chunk.z0 = cz * kChunkQuads;
+            chunk.quadsX = std::min(kChunkQuads, quadsX - chunk.x0);
+            chunk.quadsZ = std::min(kChunkQuads, quadsZ - chunk.z0);
+            chunk.lists = chunkLists(chunk.quadsX, chunk.quadsZ);
+        }
+    }
+    return true;
+}
+
+std::size_t TerrainLOD::chunkLists(int quadsX, int quadsZ)
+{
+    for (std::size_t i = 0; i < m_lists.size(); ++i)
+    {
+        if (m_lists[i].quadsX == quadsX && m_lists[i].quadsZ == quadsZ) {
+            return i;
+        }
+    }
+
+    ChunkLists lists;
+    lists.quadsX = quadsX;
+    lists.quadsZ = quadsZ;
+    // LOD 0 never stitches so it only needs mask 0
+    for (int lod = 0; lod <= kMaxLod; ++lod)
+    {
+        for (unsigned int mask = 0; mask < 16; ++mask)
+        {
+            lists.ranges[lod][mask] = (lod == 0 && mask != 0) ? lists.ranges[0][0]
+                                                              : appendChunkIndices(quadsX, quadsZ, 1 << lod, mask);
+        }
+    }
+    m_lists.push_back(lists);
+    return m_lists.size() - 1;
+}
+
+TerrainLOD::IndexRange TerrainLOD::appendChunkIndices(int quadsX, int quadsZ, int step, unsigned int edgeMask)
+{
+    IndexRange range;
+    range.first = m_indices.size();
+
+    const std::uint32_t width = m_width;
+    auto vertex = [width](int x, int z) { return static_cast<std::uint32_t>(z) * width + static_cast<std::uint32_t>(x); };
+    const int half = step / 2;
+
+    for (int z = 0; z < quadsZ; z += step)
+    {
+        // The last row and column of a chunk cut short can be narrower than step
+        const int cellZ = std::min(step, quadsZ - z);
+        for (int x = 0; x < quadsX; x += step)
+        {
+            const int cellX = std::min(step, quadsX - x);
+            // The finer neighbour only has a vertex inside the edge when the cell is wider than half a step
+            const bool west = (edgeMask & kWest) && x == 0 && cellZ > half;
+            const bool east = (edgeMask & kEast) && x + cellX == quadsX && cellZ > half;
+            const bool north = (edgeMask & kNorth) && z == 0 && cellX > half;
+            const bool south = (edgeMask & kSouth) && z + cellZ == quadsZ && cellX > half;
+
+            const std::uint32_t topLeft = vertex(x, z);
+            const std::uint32_t topRight = vertex(x + cellX, z);
+            const std::uint32_t bottomLeft = vertex(x, z + cellZ);
+            const std::uint32_t bottomRight = vertex(x + cellX, z + cellZ);
+
+            if (!(west || east || north || south))
+            {
+                // Same split and winding as the full resolution mesh
+                m_indices.insert(m_indices.end(), {topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight});
+                continue;
+            }
+
+            // Fan around the cell centre, walking the border in the same winding and
+            // picking up the finer neighbour's midpoint on stitched edges
+            std::uint32_t ring[8];
+            int count = 0;
+            int midpoint = -1;
+            auto addMidpoint = [&](std::uint32_t index) { midpoint = count; ring[count++] = index; };
+            ring[count++] = topLeft;
+            if (west) { addMidpoint(vertex(x, z + half)); }
+            ring[count++] = bottomLeft;
+            if (south) { addMidpoint(vertex(x + half, z + cellZ)); }
+            ring[count++] = bottomRight;
+            if (east) { addMidpoint(vertex(x + cellX, z + half)); }
+            ring[count++] = topRight;
+            if (north) { addMidpoint(vertex(x + half, z)); }
+
+            if (cellX >= 2 && cellZ >= 2)
+            {
+                // Any node inside the cell works as the centre, it is the middle one for full cells
+                const std::uint32_t centre = vertex(x + cellX / 2, z + cellZ / 2);
+                for (int i = 0; i < count; ++i)
+                {
+                    m_indices.insert(m_indices.end(), {centre, ring[i], ring[(i + 1) % count]});
+                }
+                continue;
+            }
+            // A cell one node thin has no inside node, fan from a midpoint instead: only the
+            // two ring edges next to it lie on its side, and those are part of its own triangles
+            for (int i = 1; i + 1 < count; ++i)
+            {
+                m_indices.insert(m_indices.end(), {ring[midpoint], ring[(midpoint + i) % count],
+                                                   ring[(midpoint + i + 1) % count]});
+            }
+        }
+    }
+
+    range.count = m_indices.size() - range.first;
+    return range;
+}
+
+void TerrainLOD::updateBounds(const HeightField& heightField)
+{
+    updateBounds(heightField, GridRect{0, 0, static_cast<int>(m_width), static_cast<int>(m_depth)});
+}
+
+void TerrainLOD::updateBounds(const HeightField& heightField, const GridRect& region)
+{
+    if (region.empty() || heightField.getWidth() != m_width || heightField.getDepth() != m_depth) {
+        return;
+    }
+
+    for (Chunk& chunk : m_chunks)
+    {
+        // A chunk owns nodes x0 .. x0 + quadsX inclusive
+        if (chunk.x0 + chunk.quadsX < region.minX || chunk.x0 >= region.maxX ||
+            chunk.z0 + chunk.quadsZ < region.minZ || chunk.z0 >= region.maxZ) {
+            continue;
+        }
+
+        float minHeight = heightField.at(chunk.x0, chunk.z0);
+        float maxHeight = minHeight;
+        for (int z = chunk.z0; z <= chunk.z0 + chunk.quadsZ; ++z)
+        {
+            const float* heights = heightField.row(z);
+            const auto range = std::minmax_element(heights + chunk.x0, heights + chunk.x0 + chunk.quadsX + 1);
+            minHeight = std::min(minHeight, *range.first);
+            maxHeight = std::max(maxHeight, *range.second);
+        }
+        chunk.minHeight = minHeight;
+        chunk.maxHeight = maxHeight;
+    }
+}
+
+float TerrainLOD::distanceToChunk(const ngl::Vec3& eye, const Chunk& chunk) const
+{
+    // Distance to the closest point of the chunk's bounding box
+    const float minX = chunk.x0 * m_spacing;
+    const float minZ = chunk.z0 * m_spacing;
+    const float maxX = (chunk.x0 + chunk.quadsX) * m_spacing;
+    const float maxZ = (chunk.z0 + chunk.quadsZ) * m_spacing;
+    const float dx = std::max({minX - eye.m_x, 0.0f, eye.m_x - maxX});
+    const float dy = std::max({chunk.minHeight - eye.m_y, 0.0f, eye.m_y - chunk.maxHeight});
+    const float dz = std::max({minZ - eye.m_z, 0.0f, eye.m_z - maxZ});
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+void TerrainLOD::select(const ngl::Vec3& eye, const float* modelViewProjection, std::vector<ChunkDraw>& draws)
+{
+    draws.clear();
+    m_selectedTriangles = 0;
+    if (m_chunks.empty()) {
+        return;
+    }
+
+    // LOD from distance, one level coarser every time the distance doubles
+    for (Chunk& chunk : m_chunks)
+    {
+        chunk.lod = 0;
+        const float distance = distanceToChunk(eye, chunk);
+        if (distance >= m_lodDistance && m_lodDistance > 0.0f) {
+            chunk.lod = std::min(kMaxLod, static_cast<int>(std::floor(std::log2(distance / m_lodDistance))) + 1);
+        }
+    }
+
+    // Neighbours may differ by one LOD at most, only the coarser side stitches.
+    // Lowering a chunk can break the rule for its other neighbours, so repeat until stable.
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int cz = 0; cz < m_chunksZ; ++cz)
+        {
+            for (int cx = 0; cx < m_chunksX; ++cx)
+            {
+                int& lod = m_chunks[cz * m_chunksX + cx].lod;
+                int limit = lod;
+                if (cx > 0) { limit = std::min(limit, getChunkLod(cx - 1, cz) + 1); }
+                if (cx + 1 < m_chunksX) { limit = std::min(limit, getChunkLod(cx + 1, cz) + 1); }
+                if (cz > 0) { limit = std::min(limit, getChunkLod(cx, cz - 1) + 1); }
+                if (cz + 1 < m_chunksZ) { limit = std::min(limit, getChunkLod(cx, cz + 1) + 1); }
+                if (limit < lod) {
+                    lod = limit;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    const Frustum frustum = Frustum::fromMatrix(modelViewProjection);
+    for (int cz = 0; cz < m_chunksZ; ++cz)
+    {
+        for (int cx = 0; cx < m_chunksX; ++cx)
+        {
+            const Chunk& chunk = m_chunks[cz * m_chunksX + cx];
+            const ngl::Vec3 boxMin(chunk.x0 * m_spacing, chunk.minHeight, chunk.z0 * m_spacing);
+            const ngl::Vec3 boxMax((chunk.x0 + chunk.quadsX) * m_spacing, chunk.maxHeight, (chunk.z0 + chunk.quadsZ) * m_spacing);
+            if (!frustum.intersectsBox(boxMin, boxMax)) {
+                continue;
+            }
+
+            unsigned int mask = 0;
+            if (cz > 0 && getChunkLod(cx, cz - 1) < chunk.lod) { mask |= kNorth; }
+            if (cx + 1 < m_chunksX && getChunkLod(cx + 1, cz) < chunk.lod) { mask |= kEast; }
+            if (cz + 1 < m_chunksZ && getChunkLod(cx, cz + 1) < chunk.lod) { mask |= kSouth; }
+            if (cx > 0 && getChunkLod(cx - 1, cz) < chunk.lod) { mask |= kWest; }
+            const IndexRange range = m_lists[chunk.lists].ranges[chunk.lod][mask];
+
+            ChunkDraw draw;
+            draw.firstIndex = range.first;
+            draw.indexCount = range.count;
+            draw.baseVertex = static_cast<std::uint32_t>(chunk.z0) * m_width + static_cast<std::uint32_t>(chunk.x0);
+            draw.lod = chunk.lod;
+            draws.push_back(draw);
+            m_selectedTriangles += range.count / 3;
+        }
+    }
+}
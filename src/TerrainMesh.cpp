@@ -0,0 +1,74 @@
+#include "TerrainMesh.h"
+
+void buildGridVertices(const HeightField& heightField, std::vector<ngl::Vec3>& vertices)
+{
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    vertices.resize(heightField.size());
+
+    for (unsigned int z = 0; z < depth; ++z)
+    {
+        ngl::Vec3* out = vertices.data() + static_cast<std::size_t>(z) * width;
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            out[x] = heightField.position(x, z);
+        }
+    }
+}
+
+void buildGridIndices(unsigned int width, unsigned int depth, std::vector<std::uint32_t>& indices)
+{
+    indices.clear();
+    if (width < 2 || depth < 2) {
+        return;
+    }
+
+    // (width-1) * (depth-1) cells, 2 triangles per cell, 3 indices per triangle
+    indices.reserve(static_cast<std::size_t>(width - 1) * (depth - 1) * 6);
+
+    for (unsigned int z = 0; z < depth - 1; ++z)
+    {
+        for (unsigned int x = 0; x < width - 1; ++x)
+        {
+            const std::uint32_t topLeft = z * width + x;
+            const std::uint32_t topRight = topLeft + 1;
+            const std::uint32_t bottomLeft = topLeft + width;
+            const std::uint32_t bottomRight = bottomLeft + 1;
+
+            // Same winding as the old duplicated vertex mesh
+            // Triangle 1: topLeft, bottomLeft, topRight
+            indices.push_back(topLeft);
+            indices.push_back(bottomLeft);
+            indices.push_back(topRight);
+
+            // Triangle 2: topRight, bottomLeft, bottomRight
+            indices.push_back(topRight);
+            indices.push_back(bottomLeft);
+            indices.push_back(bottomRight);
+        }
+    }
+}
+
+ngl::Vec3 gridVertexPosition(std::uint32_t vertexId, unsigned int width, float spacing, float height)
+{
+    // Keep in step with shaders/HeightGridVertex.glsl
+    const std::uint32_t x = vertexId % width;
+    const std::uint32_t z = vertexId / width;
+    return ngl::Vec3(static_cast<float>(x) * spacing, height, static_cast<float>(z) * spacing);
+}
+
+GridUploadRange gridUploadRange(const GridRect& rect, unsigned int width, std::size_t stride)
+{
+    GridUploadRange range;
+    if (rect.empty()) {
+        return range;
+    }
+    // From the first node of the first row to the last node of the last row, rows in between
+    // are uploaded whole since the buffer has no gaps
+    range.firstVertex = static_cast<std::size_t>(rect.minZ) * width + rect.minX;
+    const std::size_t end = static_cast<std::size_t>(rect.maxZ - 1) * width + rect.maxX;
+    range.vertexCount = end - range.firstVertex;
+    range.byteOffset = range.firstVertex * stride;
+    range.byteSize = range.vertexCount * stride;
+    return range;
+}
@@ -0,0 +1,128 @@
+#include "ThermalErosion.h"
+#include <algorithm>
+#include <utility>
+#include "ParallelFor.h"
+#include "RowStencil.h"
+
+namespace
+{
+// Node pairs share the excess with up to four neighbours at once, a fifth each brings a lone
+// spike exactly to the talus slope at a settling rate of 1 without overshooting
+constexpr float kPairShare = 0.2f;
+}
+
+std::unique_ptr<ErosionModel> ThermalErosion::clone() const
+{
+    return std::make_unique<ThermalErosion>(*this);
+}
+
+void ThermalErosion::setParameters(const ErosionParameters& parameters)
+{
+    setSettlingRate(parameters.erosionRate);
+    m_threadCount = parameters.threads;
+}
+
+ErosionParameters ThermalErosion::getParameters() const
+{
+    ErosionParameters parameters;
+    parameters.erosionRate = m_settlingRate;
+    parameters.depositionRate = 0.0f;
+    parameters.evaporationRate = 0.0f;
+    parameters.threads = m_threadCount;
+    return parameters;
+}
+
+void ThermalErosion::reset()
+{
+    m_scratch.clear();
+}
+
+void ThermalErosion::erode(HeightField& heightField, int iterations)
+{
+    const unsigned int width = heightField.getWidth();
+    const unsigned int depth = heightField.getDepth();
+    if (width < 2 || depth < 2 || iterations <= 0) {
+        return;
+    }
+    m_dirtyTiles.resize(width, depth);
+    if (m_scratch.getWidth() != width || m_scratch.getDepth() != depth ||
+        m_scratch.getSpacing() != heightField.getSpacing()) {
+        m_scratch.resize(width, depth, heightField.getSpacing());
+    }
+
+    const int tileSize = m_dirtyTiles.getTileSize();
+    const unsigned int bands = (depth + kRowsPerTask - 1) / kRowsPerTask;
+    const std::size_t chunksX = (width + tileSize - 1) / tileSize;
+    m_changedChunks.assign(bands * chunksX, 0);
+    m_bandChanged.assign(bands, 0);
+
+    for (int i = 0; i < iterations; ++i) {
+        parallelFor(bands, m_threadCount, [&](std::size_t band) {
+            const unsigned int firstRow = static_cast<unsigned int>(band) * kRowsPerTask;
+            const unsigned int lastRow = std::min(firstRow + kRowsPerTask, depth);
+            m_bandChanged[band] = relaxRows(heightField, m_scratch, firstRow, lastRow,
+                                            &m_changedChunks[band * chunksX]);
+        });
+        // Settled: the sweep wrote the same heights, so further sweeps would too
+        if (std::none_of(m_bandChanged.begin(), m_bandChanged.end(), [](char changed) { return changed != 0; })) {
+            break;
+        }
+        std::swap(heightField, m_scratch);
+    }
+
+    for (unsigned int band = 0; band < bands; ++band) {
+        const int firstRow = static_cast<int>(band * kRowsPerTask);
+        const int lastRow = static_cast<int>(std::min(band * kRowsPerTask + kRowsPerTask, depth));
+        for (std::size_t chunk = 0; chunk < chunksX; ++chunk) {
+            if (m_changedChunks[band * chunksX + chunk]) {
+                const int firstColumn = static_cast<int>(chunk) * tileSize;
+                m_dirtyTiles.mark({firstColumn, firstRow, firstColumn + tileSize, lastRow});
+            }
+        }
+    }
+}
+
+bool ThermalErosion::relaxRows(const HeightField& source, HeightField& target,
+                               unsigned int firstRow, unsigned int lastRow, char* changedChunks) const
+{
+    const std::size_t width = source.getWidth();
+    const int tileSize = m_dirtyTiles.getTileSize();
+    const float talus = m_talusSlope * source.getSpacing();
+    const float share = m_settlingRate * kPairShare;
+    const float* h = source.data();
+    float* next = target.data();
+    bool anyChanged = false;
+
+    // Material moved from a node at height a to a neighbour at height b. Both nodes evaluate
+    // exactly this expression for their pair, so the loss and the gain match bit for bit.
+    const auto slide = [talus, share](float a, float b) {
+        return share * std::max(0.0f, a - b - talus);
+    };
+
+    for (unsigned int z = firstRow; z < lastRow; ++z) {
+        const std::size_t row = static_cast<std::size_t>(z) * width;
+        // Border nodes use themselves as the missing neighbour, which never moves anything
+        const std::size_t up = z > 0 ? width : 0;
+        const std::size_t down = z + 1 < source.getDepth() ? width : 0;
+        forRowCells(width, [&](std::size_t x, bool hasLeft, bool hasRight) {
+            const std::size_t i = row + x;
+            const float height = h[i];
+            const float left = h[hasLeft ? i - 1 : i];
+            const float right = h[hasRight ? i + 1 : i];
+            const float above = h[i - up];
+            const float below = h[i + down];
+            const float lost = slide(height, left) + slide(height, right) + slide(height, above) + slide(height, below);
+            const float gained = slide(left, height) + slide(right, height) + slide(above, height) + slide(below, height);
+            next[i] = height - lost + gained;
+        });
+
+        for (std::size_t first = 0; first < width; first += tileSize) {
+            const std::size_t last = std::min(first + tileSize, width);
+            if (!std::equal(h + row + first, h + row + last, next + row + first)) {
+                changedChunks[first / tileSize] = 1;
+                anyChanged = true;
+            }
+        }
+    }
+    return anyChanged;
+}
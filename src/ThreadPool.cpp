@@ -0,0 +1,98 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+
+struct ThreadPool::Job {
+    Task task;
+    void* context;
+    std::size_t count;
+    std::atomic<std::size_t> next{0};
+    // Guarded by m_mutex: workers still to join, and workers inside work()
+    unsigned int helpersWanted = 0;
+    unsigned int helpersActive = 0;
+};
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+std::size_t ThreadPool::getWorkerCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_workers.size();
+}
+
+void ThreadPool::work(Job& job)
+{
+    for (std::size_t i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+        job.task(job.context, i);
+    }
+}
+
+void ThreadPool::run(std::size_t count, unsigned int threadCount, Task task, void* context)
+{
+    Job job;
+    job.task = task;
+    job.context = context;
+    job.count = count;
+    job.helpersWanted = static_cast<unsigned int>(std::min<std::size_t>(threadCount, count)) - 1;
+    if (job.helpersWanted > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (m_workers.size() < job.helpersWanted) {
+                m_workers.emplace_back(&ThreadPool::workerLoop, this);
+            }
+            m_jobs.push_back(&job);
+        }
+        m_wake.notify_all();
+    }
+
+    work(job);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // Every index is taken, workers that haven't joined yet must not find the job any more
+    auto queued = std::find(m_jobs.begin(), m_jobs.end(), &job);
+    if (queued != m_jobs.end()) {
+        m_jobs.erase(queued);
+    }
+    m_jobDone.wait(lock, [&job] { return job.helpersActive == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+        if (m_stopping) {
+            return;
+        }
+
+        Job* job = m_jobs.front();
+        ++job->helpersActive;
+        if (--job->helpersWanted == 0) {
+            m_jobs.pop_front();
+        }
+        lock.unlock();
+        work(*job);
+        lock.lock();
+        if (--job->helpersActive == 0) {
+            m_jobDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,345 @@
+#include "TiledHeightField.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char* const kManifestName = "heightfield.tiles";
+const char* const kManifestHeader = "TiledHeightField 1";
+const char* const kTilePrefix = "tile_";
+const char* const kTileExtension = ".r32";
+}
+
+// One tile file mapped read/write, grown to its full size when shorter
+class MappedTileFile {
+public:
+    static std::unique_ptr<MappedTileFile> map(const std::string& path, std::size_t bytes)
+    {
+        std::unique_ptr<MappedTileFile> tile(new MappedTileFile(bytes));
+#ifdef _WIN32
+        // Shared, a tile dropped from the cache can still be mapped by a reader while it is mapped again
+        tile->m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (tile->m_file == INVALID_HANDLE_VALUE) {
+            return nullptr;
+        }
+        // A mapping larger than the file extends it with zeros
+        ULARGE_INTEGER size;
+        size.QuadPart = bytes;
+        tile->m_mapping = CreateFileMappingA(tile->m_file, nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr);
+        if (!tile->m_mapping) {
+            return nullptr;
+        }
+        tile->m_data = MapViewOfFile(tile->m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+#else
+        const int file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (file < 0) {
+            return nullptr;
+        }
+        struct stat status {};
+        // A new file is extended with a hole, so untouched tiles take no disk space
+        const bool sized = fstat(file, &status) == 0 &&
+                           (static_cast<std::size_t>(status.st_size) >= bytes || ftruncate(file, static_cast<off_t>(bytes)) == 0);
+        void* data = sized ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+        // The mapping keeps the file alive on its own
+        ::close(file);
+        tile->m_data = data == MAP_FAILED ? nullptr : data;
+#endif
+        return tile->m_data ? std::move(tile) : nullptr;
+    }
+
+    ~MappedTileFile()
+    {
+#ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+        if (m_data) munmap(m_data, m_bytes);
+#endif
+    }
+
+    float* data() { return static_cast<float*>(m_data); }
+
+    bool flush()
+    {
+#ifdef _WIN32
+        return FlushViewOfFile(m_data, 0) && FlushFileBuffers(m_file);
+#else
+        return msync(m_data, m_bytes, MS_SYNC) == 0;
+#endif
+    }
+
+private:
+    explicit MappedTileFile(std::size_t bytes) : m_bytes(bytes) {}
+
+    std::size_t m_bytes;
+    void* m_data = nullptr;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+TiledHeightField::TiledHeightField() = default;
+
+TiledHeightField::~TiledHeightField()
+{
+    close();
+}
+
+bool TiledHeightField::create(const std::string& directory, unsigned int width, unsigned int depth, float spacing,
+                              unsigned int tileSize)
+{
+    close();
+    if (width == 0 || depth == 0 || tileSize == 0 || spacing <= 0.0f) {
+        std::cerr << "TiledHeightField::create() - Size, tile size and spacing must be positive." << std::endl;
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "TiledHeightField::create() - Could not create " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    // Tiles of an earlier field would show through wherever this one hasn't written yet
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind(kTilePrefix, 0) == 0 && entry.path().extension() == kTileExtension) {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+
+    m_directory = directory;
+    m_width = width;
+    m_depth = depth;
+    m_spacing = spacing;
+    m_tileSize = tileSize;
+    m_tilesX = (width + tileSize - 1) / tileSize;
+    m_tilesZ = (depth + tileSize - 1) / tileSize;
+    if (!writeManifest()) {
+        m_width = m_depth = m_tilesX = m_tilesZ = 0;
+        return false;
+    }
+    return true;
+}
+
+bool TiledHeightField::open(const std::string& directory)
+{
+    close();
+    std::ifstream manifest(std::filesystem::path(directory) / kManifestName);
+    std::string header;
+    unsigned int width = 0;
+    unsigned int depth = 0;
+    float spacing = 0.0f;
+    unsigned int tileSize = 0;
+    if (!std::getline(manifest, header) || header != kManifestHeader ||
+        !(manifest >> width >> depth >> spacing >> tileSize) ||
+        width == 0 || depth == 0 || tileSize == 0 || spacing <= 0.0f) {
+        std::cerr << "TiledHeightField::open() - No valid " << kManifestName << " in " << directory << "." << std::endl;
+        return false;
+    }
+
+    m_directory = directory;
+    m_width = width;
+    m_depth = depth;
+    m_spacing = spacing;
+    m_tileSize = tileSize;
+    m_tilesX = (width + tileSize - 1) / tileSize;
+    m_tilesZ = (depth + tileSize - 1) / tileSize;
+    return true;
+}
+
+void TiledHeightField::close()
+{
+    std::vector<TileReference> evicted;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    evictDownTo(0, evicted);
+}
+
+GridRect TiledHeightField::tileRect(unsigned int tileX, unsigned int tileZ) const
+{
+    const int firstX = static_cast<int>(tileX * m_tileSize);
+    const int firstZ = static_cast<int>(tileZ * m_tileSize);
+    return {firstX, firstZ,
+            std::min(firstX + static_cast<int>(m_tileSize), static_cast<int>(m_width)),
+            std::min(firstZ + static_cast<int>(m_tileSize), static_cast<int>(m_depth))};
+}
+
+void TiledHeightField::setCacheCapacity(std::size_t tiles)
+{
+    std::vector<TileReference> evicted;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cacheCapacity = std::max<std::size_t>(1, tiles);
+    evictDownTo(m_cacheCapacity, evicted);
+}
+
+std::size_t TiledHeightField::getMappedTiles() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_mapped.size();
+}
+
+bool TiledHeightField::read(const GridRect& rect, HeightField& heightField)
+{
+    if (rect.empty()) {
+        heightField.clear();
+        return true;
+    }
+    heightField.resize(static_cast<unsigned int>(rect.maxX - rect.minX), static_cast<unsigned int>(rect.maxZ - rect.minZ),
+                       m_spacing);
+    return copyRect(rect, heightField.data(), nullptr);
+}
+
+bool TiledHeightField::write(const GridRect& rect, const HeightField& heightField)
+{
+    if (heightField.getWidth() != static_cast<unsigned int>(std::max(0, rect.maxX - rect.minX)) ||
+        heightField.getDepth() != static_cast<unsigned int>(std::max(0, rect.maxZ - rect.minZ))) {
+        std::cerr << "TiledHeightField::write() - Height field size does not match the rect, ignoring it." << std::endl;
+        return false;
+    }
+    return rect.empty() || copyRect(rect, nullptr, heightField.data());
+}
+
+bool TiledHeightField::flush()
+{
+    std::vector<TileReference> files;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& mapped : m_mapped) {
+            files.push_back(mapped.second.file);
+        }
+    }
+    bool flushed = true;
+    for (const TileReference& file : files) {
+        flushed = file->flush() && flushed;
+    }
+    if (!flushed) {
+        std::cerr << "TiledHeightField::flush() - Could not write every tile back to " << m_directory << "." << std::endl;
+    }
+    return flushed;
+}
+
+bool TiledHeightField::writeManifest() const
+{
+    std::ofstream manifest(std::filesystem::path(m_directory) / kManifestName);
+    // Enough digits for the spacing to read back as the same float
+    manifest << kManifestHeader << "\n" << m_width << " " << m_depth << " "
+             << std::setprecision(std::numeric_limits<float>::max_digits10) << m_spacing << " " << m_tileSize << "\n";
+    if (!manifest) {
+        std::cerr << "TiledHeightField::writeManifest() - Could not write " << kManifestName << " in " << m_directory << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string TiledHeightField::tilePath(std::size_t tile) const
+{
+    const std::string name = kTilePrefix + std::to_string(tile % m_tilesX) + "_" + std::to_string(tile / m_tilesX) + kTileExtension;
+    return (std::filesystem::path(m_directory) / name).string();
+}
+
+TiledHeightField::TileReference TiledHeightField::acquireTile(std::size_t tile)
+{
+    // Declared first so tiles dropped from the cache are unmapped after the lock is released
+    std::vector<TileReference> evicted;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto cached = m_mapped.find(tile);
+        if (cached != m_mapped.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, cached->second.lruPosition);
+            return cached->second.file;
+        }
+    }
+
+    const std::size_t bytes = static_cast<std::size_t>(m_tileSize) * m_tileSize * sizeof(float);
+    TileReference file = MappedTileFile::map(tilePath(tile), bytes);
+    if (!file) {
+        std::cerr << "TiledHeightField::acquireTile() - Could not map " << tilePath(tile) << "." << std::endl;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Another thread may have mapped it meanwhile, its mapping wins and this one is dropped unlocked
+    auto cached = m_mapped.find(tile);
+    if (cached != m_mapped.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, cached->second.lruPosition);
+        evicted.push_back(std::move(file));
+        return cached->second.file;
+    }
+    evictDownTo(m_cacheCapacity - 1, evicted);
+    m_lru.push_front(tile);
+    m_mapped.emplace(tile, CachedTile{file, m_lru.begin()});
+    return file;
+}
+
+void TiledHeightField::evictDownTo(std::size_t tiles, std::vector<TileReference>& evicted)
+{
+    while (m_mapped.size() > tiles) {
+        auto oldest = m_mapped.find(m_lru.back());
+        evicted.push_back(std::move(oldest->second.file));
+        m_mapped.erase(oldest);
+        m_lru.pop_back();
+    }
+}
+
+bool TiledHeightField::copyRect(const GridRect& rect, float* readTarget, const float* writeSource)
+{
+    if (rect.minX < 0 || rect.minZ < 0 || rect.maxX > static_cast<int>(m_width) || rect.maxZ > static_cast<int>(m_depth)) {
+        std::cerr << "TiledHeightField::copyRect() - Rect lies outside the field, ignoring it." << std::endl;
+        return false;
+    }
+
+    const unsigned int tileSize = m_tileSize;
+    const std::size_t rectWidth = static_cast<std::size_t>(rect.maxX - rect.minX);
+    const unsigned int firstTileX = static_cast<unsigned int>(rect.minX) / tileSize;
+    const unsigned int lastTileX = static_cast<unsigned int>(rect.maxX - 1) / tileSize;
+    const unsigned int firstTileZ = static_cast<unsigned int>(rect.minZ) / tileSize;
+    const unsigned int lastTileZ = static_cast<unsigned int>(rect.maxZ - 1) / tileSize;
+
+    // Tile by tile, so every tile is looked up once however many rows of it the rect covers
+    for (unsigned int tileZ = firstTileZ; tileZ <= lastTileZ; ++tileZ) {
+        for (unsigned int tileX = firstTileX; tileX <= lastTileX; ++tileX) {
+            // Pinned until the copy is done, the copy itself runs unlocked
+            const TileReference reference = acquireTile(static_cast<std::size_t>(tileZ) * m_tilesX + tileX);
+            if (!reference) {
+                return false;
+            }
+            float* tile = reference->data();
+            const GridRect bounds = tileRect(tileX, tileZ);
+            const int minX = std::max(rect.minX, bounds.minX);
+            const int maxX = std::min(rect.maxX, bounds.maxX);
+            const int minZ = std::max(rect.minZ, bounds.minZ);
+            const int maxZ = std::min(rect.maxZ, bounds.maxZ);
+            const std::size_t count = static_cast<std::size_t>(maxX - minX);
+            for (int z = minZ; z < maxZ; ++z) {
+                float* tileRow = tile + static_cast<std::size_t>(z - bounds.minZ) * tileSize + (minX - bounds.minX);
+                const std::size_t rectOffset = static_cast<std::size_t>(z - rect.minZ) * rectWidth + (minX - rect.minX);
+                if (writeSource) {
+                    std::copy(writeSource + rectOffset, writeSource + rectOffset + count, tileRow);
+                } else {
+                    std::copy(tileRow, tileRow + count, readTarget + rectOffset);
+                }
+            }
+        }
+    }
+    return true;
+}
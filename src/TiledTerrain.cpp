@@ -0,0 +1,113 @@
+#include "TiledTerrain.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "HydraulicErosion.h"
+#include "PyramidErosion.h"
+
+namespace
+{
+// Blend weight along one axis for the nodes [windowMin, windowMax) of a window around the tile
+// [tileMin, tileMax). Across a border with a neighbouring tile the weight ramps from 0 to 1 over
+// `blend` nodes either side of it, mirroring the neighbour's ramp so the two add up to 1 on every node.
+void fillBlendWeights(int windowMin, int windowMax, int tileMin, int tileMax, int fieldSize, int blend,
+                      std::vector<float>& weights)
+{
+    weights.resize(static_cast<std::size_t>(windowMax - windowMin));
+    const float ramp = 1.0f / static_cast<float>(2 * std::max(blend, 1));
+    for (int i = windowMin; i < windowMax; ++i) {
+        float weight = i >= tileMin && i < tileMax ? 1.0f : 0.0f;
+        if (blend > 0) {
+            const float center = static_cast<float>(i) + 0.5f;
+            const float rising = tileMin > 0 ? (center - static_cast<float>(tileMin - blend)) * ramp : 1.0f;
+            const float falling = tileMax < fieldSize ? (static_cast<float>(tileMax + blend) - center) * ramp : 1.0f;
+            weight = std::clamp(std::min(rising, falling), 0.0f, 1.0f);
+        }
+        weights[i - windowMin] = weight;
+    }
+}
+}
+
+bool generateTiled(TerrainGenerator& generator, TiledHeightField& field, int maxHeight, const TileProgress& progress)
+{
+    const std::size_t tileCount = static_cast<std::size_t>(field.getTilesX()) * field.getTilesZ();
+    HeightField tile;
+    for (std::size_t i = 0; i < tileCount; ++i) {
+        const GridRect rect = field.tileRect(static_cast<unsigned int>(i % field.getTilesX()),
+                                             static_cast<unsigned int>(i / field.getTilesX()));
+        tile.resize(static_cast<unsigned int>(rect.maxX - rect.minX), static_cast<unsigned int>(rect.maxZ - rect.minZ),
+                    field.getSpacing());
+        generator.generateRegion(tile, static_cast<unsigned int>(rect.minX), static_cast<unsigned int>(rect.minZ),
+                                 field.getWidth(), field.getDepth(), maxHeight);
+        if (!field.write(rect, tile)) {
+            return false;
+        }
+        if (progress) {
+            progress(i + 1, tileCount);
+        }
+    }
+    return true;
+}
+
+bool erodeTiled(ErosionModel& model, TiledHeightField& field, int iterations, unsigned int halo,
+                const TileProgress& progress)
+{
+    const std::size_t tileCount = static_cast<std::size_t>(field.getTilesX()) * field.getTilesZ();
+    const int width = static_cast<int>(field.getWidth());
+    const int depth = static_cast<int>(field.getDepth());
+    const double fieldNodes = static_cast<double>(width) * depth;
+    const int reach = static_cast<int>(std::min(halo, field.getTileSize() / 2));
+    // Changes are blended over the inner quarter of the halo, the rest is only terrain for droplets and
+    // water to run on. A wider blend averages two windows' erosion over more nodes and smooths the detail.
+    const int blend = reach / 4;
+    // Windows restart the model, but the droplet sequence goes on from window to window
+    auto* droplets = dynamic_cast<HydraulicErosion*>(&PyramidErosion::fullResolutionModel(model));
+    std::uint64_t dropletCounter = droplets ? droplets->getDropletCounter() : 0;
+
+    HeightField before;
+    HeightField window;
+    std::vector<float> weightX;
+    std::vector<float> weightZ;
+    for (std::size_t i = 0; i < tileCount; ++i) {
+        const GridRect tile = field.tileRect(static_cast<unsigned int>(i % field.getTilesX()),
+                                             static_cast<unsigned int>(i / field.getTilesX()));
+        const GridRect rect{std::max(0, tile.minX - reach), std::max(0, tile.minZ - reach),
+                            std::min(width, tile.maxX + reach), std::min(depth, tile.maxZ + reach)};
+        if (!field.read(rect, before)) {
+            return false;
+        }
+        window = before;
+
+        model.reset();
+        if (droplets) {
+            droplets->setDropletCounter(dropletCounter);
+        }
+        // Every window node ends up with a full share of erosion from the windows covering it
+        const double windowNodes = static_cast<double>(rect.maxX - rect.minX) * (rect.maxZ - rect.minZ);
+        model.erode(window, model.regionIterations(iterations, windowNodes / fieldNodes));
+        // The next window resets the model, deposit what it still carries first
+        model.settle(window);
+        if (droplets) {
+            dropletCounter = droplets->getDropletCounter();
+        }
+
+        // Overlap add: the window's change fades out across the tile border, where the neighbours' fades in
+        fillBlendWeights(rect.minX, rect.maxX, tile.minX, tile.maxX, width, blend, weightX);
+        fillBlendWeights(rect.minZ, rect.maxZ, tile.minZ, tile.maxZ, depth, blend, weightZ);
+        for (unsigned int z = 0; z < window.getDepth(); ++z) {
+            const float* old = before.row(z);
+            float* heights = window.row(z);
+            const float rowWeight = weightZ[z];
+            for (unsigned int x = 0; x < window.getWidth(); ++x) {
+                heights[x] = old[x] + rowWeight * weightX[x] * (heights[x] - old[x]);
+            }
+        }
+        if (!field.write(rect, window)) {
+            return false;
+        }
+        if (progress) {
+            progress(i + 1, tileCount);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#include "TrailBuffer.h"
+#include <algorithm>
+
+void TrailBuffer::setCapacity(std::size_t capacity)
+{
+    m_capacity = capacity;
+    m_points.clear();
+    m_points.shrink_to_fit();
+    m_head = 0;
+    m_totalWritten = 0;
+    ++m_generation;
+}
+
+void TrailBuffer::clear()
+{
+    m_points.clear();
+    m_head = 0;
+    m_totalWritten = 0;
+    ++m_generation;
+}
+
+void TrailBuffer::append(const TrailBuffer& other)
+{
+    Span first;
+    Span second;
+    other.spansSince(0, first, second);
+    for (const Span& span : {first, second}) {
+        for (std::size_t i = 0; i < span.size; ++i) {
+            push(span.data[i]);
+        }
+    }
+}
+
+void TrailBuffer::spansSince(std::uint64_t written, Span& first, Span& second) const
+{
+    first = Span();
+    second = Span();
+
+    // Older points than the ring holds were overwritten already
+    const std::uint64_t oldestHeld = m_totalWritten - m_points.size();
+    const std::uint64_t from = std::max(written, oldestHeld);
+    if (from >= m_totalWritten) {
+        return;
+    }
+    const std::size_t skip = static_cast<std::size_t>(from - oldestHeld);
+    const std::size_t count = static_cast<std::size_t>(m_totalWritten - from);
+
+    // Oldest first: [head, end) then [0, head) once the ring has wrapped
+    const std::size_t start = (m_head + skip) % m_points.size();
+    const std::size_t firstSize = std::min(count, m_points.size() - start);
+    first.data = m_points.data() + start;
+    first.size = firstSize;
+    if (firstSize < count) {
+        second.data = m_points.data();
+        second.size = count - firstSize;
+    }
+}
+
+void TrailBuffer::copyTo(std::vector<ngl::Vec4>& points) const
+{
+    Span first;
+    Span second;
+    spansSince(0, first, second);
+    points.assign(first.data, first.data + first.size);
+    points.insert(points.end(), second.data, second.data + second.size);
+}
@@ -0,0 +1,34 @@
+#include "TrailUploadTracker.h"
+
+TrailUploadTracker::Update TrailUploadTracker::update(const TrailBuffer& trail)
+{
+    Update result;
+    result.capacity = trail.getCapacity();
+    result.drawCount = trail.size();
+
+    if (!m_allocated || m_capacity != trail.getCapacity()) {
+        result.reallocate = true;
+        m_allocated = true;
+        m_capacity = trail.getCapacity();
+        m_uploaded = 0;
+    }
+    // A cleared ring restarts its slots at 0, whatever is on the GPU is stale. A ring that has written
+    // fewer points than were uploaded is another trail (or a cleared one with a matching generation).
+    if (m_generation != trail.getGeneration() || trail.getTotalWritten() < m_uploaded) {
+        m_generation = trail.getGeneration();
+        m_uploaded = 0;
+    }
+
+    TrailBuffer::Span first;
+    TrailBuffer::Span second;
+    trail.spansSince(m_uploaded, first, second);
+    if (first.size != 0) {
+        // The first new point still held, the ring's second run always starts at slot 0
+        const std::uint64_t oldestHeld = trail.getTotalWritten() - trail.size();
+        const std::uint64_t from = m_uploaded > oldestHeld ? m_uploaded : oldestHeld;
+        result.ranges[0] = Range{first.data, static_cast<std::size_t>(from % m_capacity), first.size};
+        result.ranges[1] = Range{second.data, 0, second.size};
+    }
+    m_uploaded = trail.getTotalWritten();
+    return result;
+}
@@ -0,0 +1,291 @@
+/**
+ * Tests for the chunked terrain LOD (GoogleTest): LOD against distance, the one LOD step between
+ * neighbours, crack free stitching and frustum culling. The selection runs on the CPU, the
+ * index lists are checked as the triangles the GPU would draw.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+#include "HeightField.h"
+#include "TerrainLOD.h"
+
+namespace
+{
+using Vec = std::array<float, 3>;
+using Matrix = std::array<float, 16>;
+
+// Column major MVP that keeps everything within a million units of the origin inside the frustum
+Matrix seeEverything()
+{
+    Matrix m{};
+    m[0] = m[5] = m[10] = 1.0e-6f;
+    m[15] = 1.0f;
+    return m;
+}
+
+// Column major perspective(45 degrees) * lookAt(eye, target, +y), as ngl::perspective and ngl::lookAt build it
+Matrix lookAtPerspective(const Vec& eye, const Vec& target)
+{
+    auto normalise = [](Vec v) {
+        const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        return Vec{v[0] / length, v[1] / length, v[2] / length};
+    };
+    auto cross = [](const Vec& a, const Vec& b) {
+        return Vec{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+    };
+    auto dot = [](const Vec& a, const Vec& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+
+    const Vec f = normalise({target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]});
+    const Vec s = normalise(cross(f, {0.0f, 1.0f, 0.0f}));
+    const Vec u = cross(s, f);
+    const float view[4][4] = {{s[0], s[1], s[2], -dot(s, eye)},
+                              {u[0], u[1], u[2], -dot(u, eye)},
+                              {-f[0], -f[1], -f[2], dot(f, eye)},
+                              {0.0f, 0.0f, 0.0f, 1.0f}};
+
+    const float near = 0.1f;
+    const float far = 10000.0f;
+    const float t = 1.0f / std::tan(0.5f * 45.0f * 3.14159265f / 180.0f);
+    const float projection[4][4] = {{t, 0.0f, 0.0f, 0.0f},
+                                    {0.0f, t, 0.0f, 0.0f},
+                                    {0.0f, 0.0f, (far + near) / (near - far), 2.0f * far * near / (near - far)},
+                                    {0.0f, 0.0f, -1.0f, 0.0f}};
+
+    Matrix m{};
+    for (int r = 0; r < 4; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+            {
+                sum += projection[r][k] * view[k][c];
+            }
+            m[c * 4 + r] = sum;
+        }
+    }
+    return m;
+}
+
+// Flat grid with its LOD chunks laid out
+struct FlatTerrain {
+    FlatTerrain(unsigned int width, unsigned int depth, float lodDistance) : heightField(width, depth, 1.0f)
+    {
+        lod.setGrid(width, depth, 1.0f);
+        lod.updateBounds(heightField);
+        lod.setLodDistance(lodDistance);
+    }
+
+    std::vector<ChunkDraw> select(const Vec& eye, const Matrix& modelViewProjection)
+    {
+        std::vector<ChunkDraw> draws;
+        lod.select(ngl::Vec3(eye[0], eye[1], eye[2]), modelViewProjection.data(), draws);
+        return draws;
+    }
+
+    HeightField heightField;
+    TerrainLOD lod;
+};
+
+// LOD a chunk gets from its distance alone, before neighbours are taken into account
+int distanceLod(const Vec& eye, int chunkX, int chunkZ, unsigned int width, unsigned int depth, float lodDistance)
+{
+    const float minX = static_cast<float>(chunkX * TerrainLOD::kChunkQuads);
+    const float minZ = static_cast<float>(chunkZ * TerrainLOD::kChunkQuads);
+    const float maxX = std::min(minX + TerrainLOD::kChunkQuads, static_cast<float>(width - 1));
+    const float maxZ = std::min(minZ + TerrainLOD::kChunkQuads, static_cast<float>(depth - 1));
+    const float dx = std::max({minX - eye[0], 0.0f, eye[0] - maxX});
+    const float dz = std::max({minZ - eye[2], 0.0f, eye[2] - maxZ});
+    const float distance = std::sqrt(dx * dx + eye[1] * eye[1] + dz * dz);
+    if (distance < lodDistance) {
+        return 0;
+    }
+    return std::min(TerrainLOD::kMaxLod, static_cast<int>(std::floor(std::log2(distance / lodDistance))) + 1);
+}
+
+// Largest LOD step between a chunk and one of its four neighbours
+int maxNeighbourStep(const TerrainLOD& lod)
+{
+    int step = 0;
+    for (int cz = 0; cz < lod.getChunksZ(); ++cz)
+    {
+        for (int cx = 0; cx < lod.getChunksX(); ++cx)
+        {
+            if (cx + 1 < lod.getChunksX()) {
+                step = std::max(step, std::abs(lod.getChunkLod(cx, cz) - lod.getChunkLod(cx + 1, cz)));
+            }
+            if (cz + 1 < lod.getChunksZ()) {
+                step = std::max(step, std::abs(lod.getChunkLod(cx, cz) - lod.getChunkLod(cx, cz + 1)));
+            }
+        }
+    }
+    return step;
+}
+
+// Grid vertex indices of every drawn triangle, three per triangle
+std::vector<std::uint32_t> drawnTriangles(const TerrainLOD& lod, const std::vector<ChunkDraw>& draws)
+{
+    std::vector<std::uint32_t> triangles;
+    for (const ChunkDraw& draw : draws)
+    {
+        for (std::size_t i = 0; i < draw.indexCount; ++i)
+        {
+            triangles.push_back(draw.baseVertex + lod.getIndices()[draw.firstIndex + i]);
+        }
+    }
+    return triangles;
+}
+
+struct MeshCheck {
+    double area = 0.0;
+    int degenerate = 0;
+    int flipped = 0;
+    int tJunctions = 0;
+};
+
+// Checks the triangles as a mesh over the grid: no zero area triangles, one winding, and no
+// vertex lying inside another triangle's edge, which is where a crack would open
+MeshCheck checkMesh(const std::vector<std::uint32_t>& triangles, unsigned int width, unsigned int depth)
+{
+    MeshCheck check;
+    std::vector<char> used(static_cast<std::size_t>(width) * depth, 0);
+    for (std::uint32_t index : triangles)
+    {
+        used[index] = 1;
+    }
+
+    auto x = [width](std::uint32_t index) { return static_cast<int>(index % width); };
+    auto z = [width](std::uint32_t index) { return static_cast<int>(index / width); };
+    for (std::size_t t = 0; t < triangles.size(); t += 3)
+    {
+        const std::uint32_t corners[3] = {triangles[t], triangles[t + 1], triangles[t + 2]};
+        const int cross = (x(corners[1]) - x(corners[0])) * (z(corners[2]) - z(corners[0])) -
+                          (z(corners[1]) - z(corners[0])) * (x(corners[2]) - x(corners[0]));
+        if (cross == 0) {
+            ++check.degenerate;
+        }
+        // The full resolution mesh winds the other way round in x/z
+        if (cross > 0) {
+            ++check.flipped;
+        }
+        check.area += std::abs(cross) * 0.5;
+
+        for (int e = 0; e < 3; ++e)
+        {
+            const std::uint32_t a = corners[e];
+            const std::uint32_t b = corners[(e + 1) % 3];
+            const int dx = x(b) - x(a);
+            const int dz = z(b) - z(a);
+            const int steps = std::gcd(std::abs(dx), std::abs(dz));
+            for (int k = 1; k < steps; ++k)
+            {
+                const int px = x(a) + dx / steps * k;
+                const int pz = z(a) + dz / steps * k;
+                if (used[static_cast<std::size_t>(pz) * width + px]) {
+                    ++check.tJunctions;
+                }
+            }
+        }
+    }
+    return check;
+}
+}
+
+TEST(TerrainLOD, LodGrowsWithDistance)
+{
+    const float lodDistance = 64.0f;
+    FlatTerrain terrain(1025, 1025, lodDistance);
+    const Vec eye{0.0f, 10.0f, 0.0f};
+    terrain.select(eye, seeEverything());
+    const TerrainLOD& lod = terrain.lod;
+
+    EXPECT_EQ(lod.getChunkLod(0, 0), 0);
+    for (int cz = 0; cz < lod.getChunksZ(); ++cz)
+    {
+        for (int cx = 0; cx < lod.getChunksX(); ++cx)
+        {
+            // Neighbours can only pull a chunk finer
+            EXPECT_LE(lod.getChunkLod(cx, cz), distanceLod(eye, cx, cz, 1025, 1025, lodDistance));
+            if (cx > 0) {
+                EXPECT_GE(lod.getChunkLod(cx, cz), lod.getChunkLod(cx - 1, cz));
+            }
+        }
+    }
+    const int last = lod.getChunksX() - 1;
+    EXPECT_GT(lod.getChunkLod(last, last), 0);
+    EXPECT_EQ(lod.getChunkLod(last, last), distanceLod(eye, last, last, 1025, 1025, lodDistance));
+}
+
+TEST(TerrainLOD, NeighboursDifferByOneLodAtMost)
+{
+    for (unsigned int size : {300u, 1000u, 1025u})
+    {
+        // Short LOD distance, so the distance LODs alone would jump several levels between chunks
+        FlatTerrain terrain(size, size, 4.0f);
+        for (const Vec& eye : {Vec{0.0f, 2.0f, 0.0f}, Vec{150.0f, 1.0f, 200.0f}, Vec{-500.0f, 50.0f, 90.0f}})
+        {
+            terrain.select(eye, seeEverything());
+            EXPECT_LE(maxNeighbourStep(terrain.lod), 1) << "size " << size;
+        }
+    }
+}
+
+TEST(TerrainLOD, StitchingLeavesNoTJunctions)
+{
+    // Whole chunks only, chunks cut short by the border, and chunks thinner than a coarse cell
+    for (unsigned int size : {1025u, 300u, 1000u, 131u, 67u, 66u})
+    {
+        FlatTerrain terrain(size, size + 37, 4.0f);
+        for (const Vec& eye : {Vec{0.0f, 2.0f, 0.0f}, Vec{150.0f, 1.0f, 200.0f}, Vec{size * 0.9f, 3.0f, size * 0.5f}})
+        {
+            const std::vector<ChunkDraw> draws = terrain.select(eye, seeEverything());
+            ASSERT_EQ(draws.size(), static_cast<std::size_t>(terrain.lod.getChunksX() * terrain.lod.getChunksZ()));
+            const MeshCheck check = checkMesh(drawnTriangles(terrain.lod, draws), size, size + 37);
+            EXPECT_EQ(check.degenerate, 0) << "size " << size;
+            EXPECT_EQ(check.flipped, 0) << "size " << size;
+            EXPECT_EQ(check.tJunctions, 0) << "size " << size;
+            // One winding and no cracks, so the triangles tile the grid exactly when the area adds up
+            EXPECT_DOUBLE_EQ(check.area, static_cast<double>(size - 1) * (size + 36)) << "size " << size;
+        }
+    }
+}
+
+TEST(TerrainLOD, TriangleCountDoesNotGrowWithTheBorder)
+{
+    // Chunks cut short by the border drop LOD with distance like whole ones
+    FlatTerrain small(300, 300, 128.0f);
+    small.select({0.0f, 20.0f, 0.0f}, seeEverything());
+    EXPECT_GT(small.lod.getChunkLod(small.lod.getChunksX() - 1, small.lod.getChunksZ() - 1), 0);
+
+    FlatTerrain whole(2049, 2049, 128.0f);
+    FlatTerrain cut(2000, 2000, 128.0f);
+    whole.select({0.0f, 20.0f, 0.0f}, seeEverything());
+    cut.select({0.0f, 20.0f, 0.0f}, seeEverything());
+    EXPECT_LT(cut.lod.getSelectedTriangles(), whole.lod.getSelectedTriangles() * 5 / 4);
+}
+
+TEST(TerrainLOD, CullsChunksBehindTheEye)
+{
+    FlatTerrain terrain(1025, 1025, 128.0f);
+    const Vec eye{512.0f, 50.0f, 512.0f};
+    const std::vector<ChunkDraw> draws = terrain.select(eye, lookAtPerspective(eye, {1024.0f, 0.0f, 512.0f}));
+
+    ASSERT_FALSE(draws.empty());
+    EXPECT_LT(draws.size(), static_cast<std::size_t>(terrain.lod.getChunksX() * terrain.lod.getChunksZ()) / 2);
+    bool aheadDrawn = false;
+    for (const ChunkDraw& draw : draws)
+    {
+        const int x0 = static_cast<int>(draw.baseVertex % 1025);
+        const int z0 = static_cast<int>(draw.baseVertex / 1025);
+        // The chunk's far side is behind the eye
+        EXPECT_GE(x0 + TerrainLOD::kChunkQuads, static_cast<int>(eye[0])) << "chunk at " << x0 << ", " << z0;
+        aheadDrawn = aheadDrawn || (x0 == 640 && z0 == 512);
+    }
+    EXPECT_TRUE(aheadDrawn);
+}
@@ -0,0 +1,146 @@
+/**
+ * Tests for the height-only vertex stream (GoogleTest): the vertex id to x/z/height mapping the
+ * shader relies on, and the byte ranges Plane uploads for dirty rects, all without a GPU.
+ */
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include "HeightField.h"
+#include "TerrainMesh.h"
+
+namespace
+{
+// HeightGridVertex.glsl's reconstruction, written the way the shader does it: int % and / on
+// gl_VertexID, then float(...) * gridSpacing
+ngl::Vec3 shaderPosition(int vertexId, int gridWidth, float gridSpacing, float inHeight)
+{
+    const float x = static_cast<float>(vertexId % gridWidth) * gridSpacing;
+    const float z = static_cast<float>(vertexId / gridWidth) * gridSpacing;
+    return ngl::Vec3(x, inHeight, z);
+}
+
+void expectPosition(const ngl::Vec3& position, float x, float height, float z)
+{
+    EXPECT_FLOAT_EQ(position.m_x, x);
+    EXPECT_FLOAT_EQ(position.m_y, height);
+    EXPECT_FLOAT_EQ(position.m_z, z);
+}
+
+// Grid whose heights encode their node, so a byte offset can be checked by the value found there
+HeightField numberedGrid(unsigned int width, unsigned int depth)
+{
+    HeightField heightField(width, depth, 1.0f);
+    for (unsigned int z = 0; z < depth; ++z)
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            heightField.at(x, z) = static_cast<float>(z * 1000 + x);
+        }
+    }
+    return heightField;
+}
+
+float heightAtByte(const HeightField& heightField, std::size_t byteOffset)
+{
+    float height = 0.0f;
+    std::memcpy(&height, reinterpret_cast<const unsigned char*>(heightField.data()) + byteOffset, sizeof(float));
+    return height;
+}
+}
+
+TEST(TerrainMesh, HeightStreamIsOneFloatPerNode)
+{
+    EXPECT_EQ(kHeightStreamStride, sizeof(float));
+    EXPECT_EQ(kPositionStreamStride, 3 * sizeof(float));
+}
+
+TEST(TerrainMesh, VertexIdMapsToGridNode)
+{
+    const unsigned int width = 300;
+    const unsigned int depth = 200;
+    // First vertex, the end of the first row, the start of the second and the last vertex
+    expectPosition(gridVertexPosition(0, width, 1.0f, 5.0f), 0.0f, 5.0f, 0.0f);
+    expectPosition(gridVertexPosition(width - 1, width, 1.0f, 6.0f), 299.0f, 6.0f, 0.0f);
+    expectPosition(gridVertexPosition(width, width, 1.0f, 7.0f), 0.0f, 7.0f, 1.0f);
+    expectPosition(gridVertexPosition(width * depth - 1, width, 1.0f, 8.0f), 299.0f, 8.0f, 199.0f);
+}
+
+TEST(TerrainMesh, VertexIdScalesBySpacing)
+{
+    expectPosition(gridVertexPosition(3 * 17 + 5, 17, 0.25f, -2.0f), 1.25f, -2.0f, 0.75f);
+    expectPosition(gridVertexPosition(17 * 40 - 1, 17, 2.5f, 0.0f), 40.0f, 0.0f, 97.5f);
+}
+
+TEST(TerrainMesh, VertexIdMatchesHeightGridShader)
+{
+    const HeightField heightField = numberedGrid(37, 23);
+    for (float spacing : {1.0f, 0.3f, 4.0f})
+    {
+        for (std::uint32_t id = 0; id < heightField.size(); ++id)
+        {
+            const ngl::Vec3 cpu = gridVertexPosition(id, heightField.getWidth(), spacing, heightField[id]);
+            const ngl::Vec3 gpu = shaderPosition(static_cast<int>(id), static_cast<int>(heightField.getWidth()), spacing,
+                                                 heightField[id]);
+            ASSERT_EQ(cpu.m_x, gpu.m_x) << "vertex " << id;
+            ASSERT_EQ(cpu.m_y, gpu.m_y) << "vertex " << id;
+            ASSERT_EQ(cpu.m_z, gpu.m_z) << "vertex " << id;
+            // And the node the vertex stands for
+            ASSERT_EQ(heightField.position(id % heightField.getWidth(), id / heightField.getWidth()).m_y, cpu.m_y);
+        }
+    }
+}
+
+TEST(TerrainMesh, UploadRangeOfInteriorRect)
+{
+    const HeightField heightField = numberedGrid(100, 80);
+    const GridRect rect{10, 20, 30, 25};
+    const GridUploadRange range = gridUploadRange(rect, 100, kHeightStreamStride);
+
+    // From node (10, 20) to node (29, 24) inclusive, the rows in between whole
+    EXPECT_EQ(range.firstVertex, 20u * 100 + 10);
+    EXPECT_EQ(range.vertexCount, (24u * 100 + 30) - (20u * 100 + 10));
+    EXPECT_EQ(range.byteOffset, range.firstVertex * sizeof(float));
+    EXPECT_EQ(range.byteSize, range.vertexCount * sizeof(float));
+    EXPECT_EQ(heightAtByte(heightField, range.byteOffset), heightField.at(10, 20));
+    EXPECT_EQ(heightAtByte(heightField, range.byteOffset + range.byteSize - sizeof(float)), heightField.at(29, 24));
+}
+
+TEST(TerrainMesh, UploadRangeOfEdgeRects)
+{
+    const HeightField heightField = numberedGrid(100, 80);
+
+    // Last column of the grid, rows 5 to 9
+    GridUploadRange range = gridUploadRange(GridRect{99, 5, 100, 10}, 100, kHeightStreamStride);
+    EXPECT_EQ(heightAtByte(heightField, range.byteOffset), heightField.at(99, 5));
+    EXPECT_EQ(heightAtByte(heightField, range.byteOffset + range.byteSize - sizeof(float)), heightField.at(99, 9));
+    EXPECT_EQ(range.byteSize, (4u * 100 + 1) * sizeof(float));
+
+    // Bottom row, ending on the buffer's last byte
+    range = gridUploadRange(GridRect{0, 79, 100, 80}, 100, kHeightStreamStride);
+    EXPECT_EQ(range.byteOffset, 79u * 100 * sizeof(float));
+    EXPECT_EQ(range.byteOffset + range.byteSize, heightField.size() * sizeof(float));
+
+    // A single node in the first row
+    range = gridUploadRange(GridRect{0, 0, 1, 1}, 100, kHeightStreamStride);
+    EXPECT_EQ(range.byteOffset, 0u);
+    EXPECT_EQ(range.byteSize, sizeof(float));
+
+    // Nothing to upload
+    range = gridUploadRange(GridRect{5, 5, 5, 9}, 100, kHeightStreamStride);
+    EXPECT_EQ(range.byteSize, 0u);
+}
+
+TEST(TerrainMesh, UploadRangeOfWholeGrid)
+{
+    const GridUploadRange range = gridUploadRange(GridRect{0, 0, 100, 80}, 100, kHeightStreamStride);
+    EXPECT_EQ(range.firstVertex, 0u);
+    EXPECT_EQ(range.vertexCount, 100u * 80);
+    EXPECT_EQ(range.byteOffset, 0u);
+    EXPECT_EQ(range.byteSize, 100u * 80 * sizeof(float));
+
+    // The position stream covers the same vertices, three floats each
+    const GridUploadRange positions = gridUploadRange(GridRect{0, 0, 100, 80}, 100, kPositionStreamStride);
+    EXPECT_EQ(positions.vertexCount, range.vertexCount);
+    EXPECT_EQ(positions.byteSize, 3 * range.byteSize);
+}
@@ -0,0 +1,191 @@
+/**
+ * Tests for the incremental trail upload (GoogleTest): what TrailUploadTracker asks to be copied
+ * into the GPU ring after appends, wraps, clears, capacity changes and a swap to another trail.
+ * The updates are applied to a CPU mirror of the GPU buffer, which must then match the ring.
+ */
+
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TrailBuffer.h"
+#include "TrailUploadTracker.h"
+
+namespace
+{
+// The GPU buffer, slot for slot, as the renderer would keep it
+struct GpuMirror {
+    std::vector<float> slots;
+    std::size_t drawCount = 0;
+
+    void apply(const TrailUploadTracker::Update& update) {
+        if (update.reallocate) {
+            slots.assign(update.capacity, -1.0f);
+        }
+        for (const TrailUploadTracker::Range& range : update.ranges) {
+            ASSERT_LE(range.firstSlot + range.count, slots.size());
+            for (std::size_t i = 0; i < range.count; ++i) {
+                slots[range.firstSlot + i] = range.data[i].m_x;
+            }
+        }
+        drawCount = update.drawCount;
+    }
+};
+
+// Points carry their write number in x
+void pushPoints(TrailBuffer& trail, int from, int count)
+{
+    for (int i = from; i < from + count; ++i) {
+        trail.push(ngl::Vec4(static_cast<float>(i), 0.0f, 0.0f, 0.0f));
+    }
+}
+
+std::size_t uploadedPoints(const TrailUploadTracker::Update& update)
+{
+    return update.ranges[0].count + update.ranges[1].count;
+}
+
+// Point k of the ring lives in slot k % capacity
+void expectMirrors(const GpuMirror& gpu, const TrailBuffer& trail)
+{
+    ASSERT_EQ(gpu.drawCount, trail.size());
+    const std::uint64_t oldestHeld = trail.getTotalWritten() - trail.size();
+    for (std::uint64_t k = oldestHeld; k < trail.getTotalWritten(); ++k) {
+        EXPECT_EQ(gpu.slots[k % trail.getCapacity()], static_cast<float>(k)) << "point " << k;
+    }
+}
+}
+
+TEST(TrailUploadTracker, FirstUpdateUploadsEverything)
+{
+    TrailBuffer trail(16);
+    pushPoints(trail, 0, 10);
+    TrailUploadTracker tracker;
+    GpuMirror gpu;
+
+    const TrailUploadTracker::Update update = tracker.update(trail);
+    EXPECT_TRUE(update.reallocate);
+    EXPECT_EQ(update.capacity, 16u);
+    EXPECT_EQ(update.ranges[0].firstSlot, 0u);
+    EXPECT_EQ(uploadedPoints(update), 10u);
+    gpu.apply(update);
+    expectMirrors(gpu, trail);
+
+    // Nothing new, nothing to copy
+    const TrailUploadTracker::Update idle = tracker.update(trail);
+    EXPECT_FALSE(idle.reallocate);
+    EXPECT_EQ(uploadedPoints(idle), 0u);
+    EXPECT_EQ(idle.drawCount, 10u);
+}
+
+TEST(TrailUploadTracker, AppendUploadsOnlyNewPoints)
+{
+    TrailBuffer trail(16);
+    pushPoints(trail, 0, 5);
+    TrailUploadTracker tracker;
+    GpuMirror gpu;
+    gpu.apply(tracker.update(trail));
+
+    pushPoints(trail, 5, 4);
+    const TrailUploadTracker::Update update = tracker.update(trail);
+    EXPECT_FALSE(update.reallocate);
+    EXPECT_EQ(update.ranges[0].firstSlot, 5u);
+    EXPECT_EQ(update.ranges[0].count, 4u);
+    EXPECT_EQ(update.ranges[1].count, 0u);
+    gpu.apply(update);
+    expectMirrors(gpu, trail);
+}
+
+TEST(TrailUploadTracker, WrapSplitsIntoTwoRanges)
+{
+    TrailBuffer trail(16);
+    pushPoints(trail, 0, 12);
+    TrailUploadTracker tracker;
+    GpuMirror gpu;
+    gpu.apply(tracker.update(trail));
+
+    // Points 12..19 go to slots 12..15 and then 0..3
+    pushPoints(trail, 12, 8);
+    const TrailUploadTracker::Update update = tracker.update(trail);
+    EXPECT_FALSE(update.reallocate);
+    EXPECT_EQ(update.ranges[0].firstSlot, 12u);
+    EXPECT_EQ(update.ranges[0].count, 4u);
+    EXPECT_EQ(update.ranges[1].firstSlot, 0u);
+    EXPECT_EQ(update.ranges[1].count, 4u);
+    gpu.apply(update);
+    expectMirrors(gpu, trail);
+
+    // More than a whole ring since the last look only uploads what is still held
+    pushPoints(trail, 20, 40);
+    const TrailUploadTracker::Update lapped = tracker.update(trail);
+    EXPECT_EQ(uploadedPoints(lapped), 16u);
+    gpu.apply(lapped);
+    expectMirrors(gpu, trail);
+}
+
+TEST(TrailUploadTracker, ClearRestartsAtSlotZero)
+{
+    TrailBuffer trail(16);
+    pushPoints(trail, 0, 10);
+    TrailUploadTracker tracker;
+    GpuMirror gpu;
+    gpu.apply(tracker.update(trail));
+
+    const std::uint64_t generation = trail.getGeneration();
+    trail.clear();
+    EXPECT_NE(trail.getGeneration(), generation);
+    // Even with more points than before the clear, the old slots are stale
+    pushPoints(trail, 0, 12);
+    const TrailUploadTracker::Update update = tracker.update(trail);
+    EXPECT_FALSE(update.reallocate);
+    EXPECT_EQ(update.ranges[0].firstSlot, 0u);
+    EXPECT_EQ(uploadedPoints(update), 12u);
+    gpu.apply(update);
+    expectMirrors(gpu, trail);
+}
+
+TEST(TrailUploadTracker, CapacityChangeReallocates)
+{
+    TrailBuffer trail(16);
+    pushPoints(trail, 0, 10);
+    TrailUploadTracker tracker;
+    GpuMirror gpu;
+    gpu.apply(tracker.update(trail));
+
+    trail.setCapacity(32);
+    pushPoints(trail, 0, 20);
+    const TrailUploadTracker::Update update = tracker.update(trail);
+    EXPECT_TRUE(update.reallocate);
+    EXPECT_EQ(update.capacity, 32u);
+    EXPECT_EQ(uploadedPoints(update), 20u);
+    gpu.apply(update);
+    expectMirrors(gpu, trail);
+
+    // reset() forces the same for a new GL buffer
+    tracker.reset();
+    const TrailUploadTracker::Update fresh = tracker.update(trail);
+    EXPECT_TRUE(fresh.reallocate);
+    EXPECT_EQ(uploadedPoints(fresh), 20u);
+}
+
+TEST(TrailUploadTracker, SwapToAnotherTrailUploadsEverything)
+{
+    TrailBuffer first(16);
+    pushPoints(first, 0, 12);
+    TrailUploadTracker tracker;
+    GpuMirror gpu;
+    gpu.apply(tracker.update(first));
+
+    // Same capacity and generation, fewer points written: nothing tells it apart but the count
+    TrailBuffer second(16);
+    pushPoints(second, 100, 5);
+    ASSERT_EQ(second.getGeneration(), first.getGeneration());
+    const TrailUploadTracker::Update update = tracker.update(second);
+    EXPECT_EQ(update.ranges[0].firstSlot, 0u);
+    EXPECT_EQ(uploadedPoints(update), 5u);
+    EXPECT_EQ(update.drawCount, 5u);
+    gpu.apply(update);
+    for (std::size_t slot = 0; slot < 5; ++slot) {
+        EXPECT_EQ(gpu.slots[slot], static_cast<float>(100 + slot));
+    }
+}